@@ -0,0 +1,40 @@
+#!/bin/bash
+# Compare microbenchmark results with a baseline.
+#
+#   ./bench-compare.sh baseline.txt results.txt [percent]
+#
+# Both files hold one item per line, its name and the cycles per operation, as
+# written by bench-read.sh on the target, or by host/bench/micro on the host.
+# Lines starting with # are comments. An item is a regression if it takes more
+# than the given percentage longer than in the baseline, 10 % by default. On
+# the target, it must also be at least one cycle longer, which is the
+# resolution of its counter. Host results, recognized by the "host build" in
+# their header, are compared by the percentage alone, as the host resolves
+# fractions of a cycle. The exit code is 1 if there is a regression. Only
+# compare results of the same kind of machine.
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 baseline results [percent]" >&2
+    exit 2
+fi
+
+awk -v pct=${3:-10} -v minimum=1 '
+    /^# .*host build/ { minimum = 0 }
+    /^#/ || NF < 2 { next }
+    FNR == NR { base[$1] = $2; next }
+    $1 == "loop" { next }
+    !($1 in base) { printf "%-14s %10s %10.2f  new\n", $1, "-", $2; next }
+    {
+        d = base[$1] > 0 ? 100 * ($2 - base[$1]) / base[$1] : 0
+        bad = $2 > base[$1] * (1 + pct / 100) && $2 - base[$1] >= minimum
+        printf "%-14s %10.2f %10.2f %+7.1f %%%s\n", $1, base[$1], $2, d, bad ? "  REGRESSION" : ""
+        failed += bad
+        seen[$1] = 1
+    }
+    END {
+        for (n in base)
+            if (n != "loop" && !(n in seen))
+                printf "%-14s %10.2f %10s  missing\n", n, base[n], "-"
+        exit failed > 0
+    }
+' "$1" "$2"
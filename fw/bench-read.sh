@@ -0,0 +1,29 @@
+#!/bin/bash
+# Read the microbenchmark results of the AES42HAT, in the format of
+# bench-compare.sh. The firmware must be built with the option AES42HAT_BENCH.
+# The results are in window 0x04 of the board control registers: the cycles of
+# the empty loop, then the cycles per operation of each item, in units of 1/16
+# cycle, as 16-bit words.
+#
+#   ./bench-read.sh > results.txt
+
+set -e
+BUS=1
+ADDR=0x74
+NAMES=(queuePushPop queueRotate stackPushPop coroResume diff48 diff48Ref lookup taskResume taskCreate seqCoro seqTask)
+SIZE=$(( 2 + 2 * ${#NAMES[@]} ))
+
+i2cset -y $BUS $ADDR 0x01 0x04
+if (( ($(i2cget -y $BUS $ADDR 0x02) | $(i2cget -y $BUS $ADDR 0x03) << 8) < SIZE )); then
+    echo "no benchmark results, is the firmware built with AES42HAT_BENCH?" >&2
+    exit 1
+fi
+BYTES=($(i2ctransfer -y $BUS w1@$ADDR 0x80 r$SIZE@$ADDR))
+word() { echo $(( ${BYTES[$1]} | ${BYTES[$1 + 1]} << 8 )); }
+
+echo "# AES42HAT microbenchmarks, cycles per operation"
+echo "# LPC865 target, firmware version $(i2cget -y $BUS $ADDR 0x7F), $(date +%F)"
+echo "loop $(word 0)"
+for i in ${!NAMES[@]}; do
+    awk -v n=${NAMES[$i]} -v c=$(word $(( 2 + 2 * i ))) 'BEGIN { printf "%s %.2f\n", n, c / 16 }'
+done
@@ -0,0 +1,67 @@
+/** @file
+ * The microbenchmarks of the module bench, on the host.
+ *
+ * Usage: micro [runs]
+ *
+ * Runs the benchmarks a number of times, 200 by default, and prints the
+ * smallest result of each item, in cycles per operation, in the format that
+ * bench-read.sh produces from the board control window of the target, so that
+ * bench-compare.sh can compare both kinds of results with a baseline. The
+ * cycles are those of the time stamp counter of the host, which says nothing
+ * about the cycles on the target, but shows regressions of the code all the
+ * same, as long as the results are compared on the same machine.
+ */
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+
+import bench;
+
+namespace {
+
+/** Names of the items, in the order of bench::Item. */
+constexpr char const *names[bench::itemCount] = {
+    "queuePushPop",
+    "queueRotate",
+    "stackPushPop",
+    "coroResume",
+    "diff48",
+    "diff48Ref",
+    "lookup",
+    "taskResume",
+    "taskCreate",
+    "seqCoro",
+    "seqTask",
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    unsigned runs = argc > 1 ? unsigned(std::strtoul(argv[1], nullptr, 10)) : 200;
+    if (runs == 0) {
+        std::fprintf(stderr, "usage: %s [runs]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bench::Results best;
+    std::memset(&best, 0xFF, sizeof best);
+    for (unsigned r = 0; r < runs; ++r) {
+        bench::Results res;
+        auto bytes = bench::run();
+        std::memcpy(&res, bytes.data(), std::min(bytes.size(), sizeof res));
+        best.loop = std::min(best.loop, res.loop);
+        for (unsigned i = 0; i < bench::itemCount; ++i)
+            best.cycles[i] = std::min(best.cycles[i], res.cycles[i]);
+    }
+
+    std::printf("# AES42HAT microbenchmarks, cycles per operation\n");
+    std::printf("# x86-64 host build, time stamp counter cycles, best of %u runs\n", runs);
+    std::printf("loop %u\n", unsigned(best.loop));
+    for (unsigned i = 0; i < bench::itemCount; ++i)
+        std::printf("%s %.2f\n", names[i], best.cycles[i] / 16.0);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,243 @@
+/** @file
+ * Benchmark of the block pipeline of four channels, in the host simulation.
+ *
+ * Usage: pipeline <sampling rate in Hz> [spread]
+ *
+ * Four SRC4392 models receive and transmit blocks at the given rate. Their
+ * receivers are locked to the same source, so their block starts are a few
+ * samples apart, unless spread is given, which spreads them evenly over the
+ * block period. The firmware brings the chips up, and then runs the status,
+ * page 1 and transmit sequences of every block, as on the target. After a
+ * warm-up, one second is measured, and printed as a row of the table in the
+ * Readme. The exit code is non-zero if a block was missed, a read was late,
+ * or the model found a protocol violation, and in sync mode also if no reads
+ * were coalesced.
+ */
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+
+import handler;
+import sim;
+import src4392_model;
+import FTM;
+import MRT;
+import PINT;
+import SPI;
+import SRC4392;
+import ftm_drv;
+import mrt_drv;
+import pint_drv;
+import spi_drv;
+import spi_queue;
+import src4392_drv;
+import src4392_init;
+import timer;
+import channel;
+import clkmgr;
+
+namespace {
+
+constexpr unsigned channels = Channel::maxChannels;
+constexpr sim::Time second = 1000000000;
+
+// The same as in main.cpp
+constexpr uint32_t froHz = 60000000;
+constexpr lpc865::Spi::Clocking p_spi = {
+    .fclk = froHz,
+    .maxHz = 30000000,
+    .readNs = 60,
+    .leadNs = 50,
+    .lagNs = 50,
+    .gapNs = 100,
+};
+
+constexpr lpc865::Ftm::Parameters ftm0par{ .ps=3, .clks=1, .mod=0xFFFF
+    , .ch = {
+        { .mode=lpc865::Ftm::capturePos },     // BLS time stamping
+        { .mode=lpc865::Ftm::compare },        // Holding status reads for coalescing
+        { .mode=lpc865::Ftm::captureNeg },     // INTA time stamping
+        { .mode=lpc865::Ftm::captureNeg },     // INTB time stamping
+        { .mode=lpc865::Ftm::captureNeg },     // INTC time stamping
+        { .mode=lpc865::Ftm::captureNeg }      // INTD time stamping
+    }
+};
+
+/** The block synchronization signal of the transmitters, high for the first
+ * half of each block.
+ */
+class Bls : sim::Event {
+public:
+    void start(sim::Time first, sim::Time period) {
+        period_ = period;
+        sim::schedule(*this, first);
+    }
+
+    sim::Line line{ false };
+
+private:
+    void fire(sim::Time t) override {
+        bool rise = !line.level();
+        line.set(rise, t);
+        sim::schedule(*this, t + (rise ? period_ / 2 : period_ - period_ / 2));
+    }
+
+    sim::Time period_ = 0;
+};
+
+/** The board, with the firmware objects wired up as in main.cpp. */
+struct Board {
+    sim::Session session;
+    sim::SpiModel bus;
+    sim::PintModel pins;
+    sim::FtmModel ftmModel;
+    sim::MrtModel mrtModel{ froHz };
+    std::array<sim::Src4392Model, channels> chips;
+    Bls bls;
+
+    lpc865::SPI::Intgr spiIn{ &bus };
+    lpc865::PINT::Intgr pintIn{ &pins };
+    lpc865::FTM::Intgr ftmIn{ &ftmModel, 5 };
+    lpc865::MRT::Intgr mrtIn{ &mrtModel };
+
+    lpc865::Pint pint{ pintIn };
+    lpc865::Ftm ftm0{ ftmIn, ftm0par };
+    lpc865::Mrt mrt{ mrtIn };
+    TimerWheel timers{ mrt };
+    lpc865::Spi spi0{ spiIn, nullptr, p_spi };
+    lpc865::SpiQueue spique{ spi0 };
+    Channel::Integration integration[channels] = {
+        { .in={ .addr = 0, .cpm = 0, .src_present=1 }, .irq=0, .tch=2, .rch=0, .mch=1, .base=src4392::initBase, .overrides=src4392::initChannelA },
+        { .in={ .addr = 1, .cpm = 0, .src_present=1 }, .irq=1, .tch=3, .rch=0, .mch=1, .base=src4392::initBase },
+        { .in={ .addr = 2, .cpm = 0, .src_present=1 }, .irq=2, .tch=4, .rch=0, .mch=1, .base=src4392::initBase },
+        { .in={ .addr = 3, .cpm = 0, .src_present=1 }, .irq=3, .tch=5, .rch=0, .mch=1, .base=src4392::initBase },
+    };
+    Channel chan[channels] = {
+        { integration[0], spique, ftm0, pint },
+        { integration[1], spique, ftm0, pint },
+        { integration[2], spique, ftm0, pint },
+        { integration[3], spique, ftm0, pint },
+    };
+    Clkmgr clkmgr{ pint, chan, 4 };
+    ChannelManagement mgmt{ chan, spique, timers };
+
+    /** @param fs Sampling rate of the receivers and transmitters */
+    explicit Board(uint32_t fs)
+        : ftmModel{ 8 * fs }    // the FTM0 tick is 8 bit clocks of the transmit side
+    {
+        for (unsigned n = 0; n < channels; ++n) {
+            bus.connect(n, chips[n]);
+            pins.connect(n, chips[n].irq);
+            ftmModel.connect(2 + n, chips[n].irq);
+        }
+        pins.connect(4, bls.line);
+        ftmModel.connect(0, bls.line);
+    }
+};
+
+/** Measured values of the window. */
+struct Result {
+    uint64_t blocks;            //!< Blocks received by the chips
+    uint64_t handled;           //!< Blocks handled by the channels
+    uint64_t missed;
+    uint64_t late;
+    uint64_t straddles;         //!< Straddles found by the channels
+    uint64_t coalesced;         //!< Reads chained to those of another channel
+    uint64_t violations;        //!< Protocol violations found by the model
+    uint64_t worstTicks;        //!< Longest time from block start to page 1 read complete
+    sim::Time spiBusy;
+    sim::Time cpuBusy;
+    uint64_t bytes;             //!< Bytes clocked on the bus
+    uint64_t dataBytes;         //!< Bytes of the data phases
+};
+
+Result snapshot(Board const &b) {
+    Result r{};
+    Channel::Stats st[channels];
+    std::memcpy(st, Channel::stats().data(), sizeof st);
+    for (unsigned n = 0; n < channels; ++n) {
+        r.blocks += b.chips[n].rxBlocks();
+        r.handled += st[n].blocks;
+        r.missed += st[n].missed;
+        r.late += st[n].late;
+        r.straddles += st[n].straddles;
+        r.coalesced += st[n].coalesced;
+        r.violations += b.chips[n].violations().total();
+        r.worstTicks = std::max<uint64_t>(r.worstTicks, st[n].worstLatency);
+        r.bytes += b.chips[n].traffic().bytes;
+        r.dataBytes += b.chips[n].traffic().dataBytes;
+    }
+    r.spiBusy = b.bus.stats().busy;
+    r.cpuBusy = sim::load().busy;
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <sampling rate in Hz> [spread]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    uint32_t fs = uint32_t(std::strtoul(argv[1], nullptr, 10));
+    bool spread = argc > 2 && std::strcmp(argv[2], "spread") == 0;
+    if (fs < 32000 || fs > 216000) {
+        std::fprintf(stderr, "sampling rate out of range\n");
+        return EXIT_FAILURE;
+    }
+
+    Board b{ fs };
+    sim::Time period = 192 * second / fs;
+    sim::Time sample = second / fs;
+
+    // Bring the chips up, as after reset, then let the sources lock
+    b.timers.start(0, froHz / 1000);
+    b.mgmt.post();
+    sim::Time start = 10 * 1000000;
+    b.bls.start(start, period);
+    for (unsigned n = 0; n < channels; ++n) {
+        b.chips[n].startTransmitter(start, period);
+        sim::Time offset = spread ? n * period / channels : (period / 3 + 2 * n * sample);
+        b.chips[n].startReceiver(start + offset, period);
+    }
+
+    // Warm up, so that the block periods are learned
+    sim::run(start + 50 * period);
+    Result r0 = snapshot(b);
+    sim::Time t0 = sim::now();
+    sim::run(t0 + second);
+    Result r1 = snapshot(b);
+    sim::Time window = sim::now() - t0;
+
+    uint64_t blocks = r1.blocks - r0.blocks;
+    uint64_t handled = r1.handled - r0.handled;
+    uint64_t missed = r1.missed - r0.missed;
+    uint64_t late = r1.late - r0.late;
+    uint64_t straddles = r1.straddles - r0.straddles;
+    uint64_t violations = r1.violations - r0.violations;
+    uint64_t coalesced = r1.coalesced - r0.coalesced;
+    double spi = 100.0 * double(r1.spiBusy - r0.spiBusy) / double(window);
+    double cpu = 100.0 * double(r1.cpuBusy - r0.cpuBusy) / double(window);
+    double periods = double(window) / double(period);
+    double bytes = double(r1.bytes - r0.bytes) / periods;
+    double data = double(r1.dataBytes - r0.dataBytes) / periods;
+    double budget = 800000.0 * double(period) / double(second);     // 800 kByte/s, see the Readme
+    double worstUs = double(r1.worstTicks) * 1e6 / (8.0 * fs);
+
+    std::printf("| %5.1f kHz | %-6s | %4llu / %4llu | %llu / %llu / %llu / %llu | %5llu | %4.0f µs | %4.1f %% | %4.1f %% | %3.0f (%3.0f) / %4.0f |\n",
+                fs / 1000.0, spread ? "spread" : "sync",
+                (unsigned long long)handled, (unsigned long long)blocks,
+                (unsigned long long)missed, (unsigned long long)late,
+                (unsigned long long)straddles, (unsigned long long)violations,
+                (unsigned long long)coalesced, worstUs, spi, cpu, bytes, data, budget);
+
+    bool ok = handled == blocks && missed == 0 && late == 0 && straddles == 0 && violations == 0
+           && b.bus.stats().overlaps == 0 && b.bus.stats().contention == 0
+           && (spread || coalesced > 0);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,25 @@
+/** @file
+ * Minimal checks for the host tests.
+ */
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+/** Count a failed condition, and report where it is. */
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++checkFailures; \
+        } \
+    } while (0)
+
+inline int checkFailures = 0;
+
+/** Exit code of a test. */
+inline int checkResult() {
+    if (checkFailures)
+        std::fprintf(stderr, "%d checks failed\n", checkFailures);
+    return checkFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+/** @file
+ * FTM driver, on the FTM model of the host simulation.
+ * @addtogroup Host
+ * @{
+ */
+module;
+#include <bit>
+#include <cstdint>
+#include <utility>
+module ftm_drv;
+import FTM;
+import sim;
+
+using namespace lpc865::FTM;
+
+uint16_t lpc865::Ftm::getCount() {
+    return in_.model->count();
+}
+
+/** Outputs aren't modeled. */
+void lpc865::Ftm::setMatch(unsigned, uint16_t) {
+}
+
+bool lpc865::Ftm::armMatch(unsigned ch, uint16_t value, Handler &hdl) {
+    if (int16_t(getCount() - value) >= 0)
+        return false;
+    match_[ch] = &hdl;
+    in_.model->compare(ch, value);
+    return true;
+}
+
+uint16_t lpc865::Ftm::getCapture(unsigned ch) {
+    return in_.model->capture(ch);
+}
+
+uintptr_t lpc865::Ftm::captureAddress(unsigned ch) const {
+    return reinterpret_cast<uintptr_t>(&in_.model->capture(ch));
+}
+
+/** The counter of the model runs freely, so there are no overflow or reload
+ * interrupts.
+ */
+void lpc865::Ftm::setHandlers(Handler *overflow, Handler *reload) {
+    overflow_ = overflow;
+    reload_ = reload;
+}
+
+void lpc865::Ftm::setModulusDelta(int16_t) {
+}
+
+lpc865::Ftm::Ftm(Intgr const &in, Parameters const &par)
+    : mod_{par.mod}
+    , in_{in}
+    , overflow_{nullptr}
+    , reload_{nullptr}
+    , match_{}
+{
+    for (unsigned i = 0; i <= in_.max_channel; ++i)
+        in_.model->configure(i, par.ch[i].mode);
+    in_.model->attach(*this);
+}
+
+void lpc865::Ftm::isr() {
+    uint32_t flags = in_.model->takeFlags();
+    while (flags) {
+        unsigned ch = std::countr_zero(flags);
+        flags &= flags - 1;
+        if (ch <= in_.max_channel && match_[ch])
+            std::exchange(match_[ch], nullptr)->post();
+    }
+}
+
+/** @}*/
@@ -0,0 +1,68 @@
+/** @file
+ * driver for the LPC8 I2C block in target mode, on the I2C model of the host
+ * simulation.
+ * @addtogroup Host
+ * @{
+ */
+module;
+#include <cstddef>
+#include <cstdint>
+module i2c_tgt_drv;
+import I2C;
+import sim;
+
+using namespace lpc865::I2C;
+
+void lpc865::I2cTarget::isr() {
+    auto &bus = *in_.model;
+    auto stat = bus.status();
+    if (stat.deselected) {
+        if (selected_)
+            selected_->deselect();
+        bus.clearDeselect();
+    }
+    if (stat.pending) {
+        switch (stat.state) {
+        case sim::I2cModel::address:
+            target_ = stat.data;
+            selected_ = nullptr;
+            for (auto callback : par_.callbacks) {
+                if (callback->select(target_)) {
+                    selected_ = callback;
+                    break;
+                }
+            }
+            if (!selected_)
+                target_ = 0xFF;
+            bus.serve(selected_ != nullptr);
+            break;
+        case sim::I2cModel::receive:
+            if (selected_)
+                selected_->putRxByte(stat.data);
+            bus.serve();
+            break;
+        case sim::I2cModel::transmit:
+            if (selected_)
+                bus.reply(selected_->getTxByte());
+            bus.serve();
+            break;
+        }
+    } else {
+        target_ = 0xFF;
+        selected_ = nullptr;
+    }
+}
+
+/** The address matching is left to the callbacks, which check the address
+ * themselves anyway.
+ */
+lpc865::I2cTarget::I2cTarget(Intgr const &in, Parameters const &par)
+    : target_{0xFF}
+    , selected_{nullptr}
+    , in_{in}
+    , par_{par}
+{
+    in_.model->attach(*this);
+}
+
+/** @}*/
@@ -0,0 +1,47 @@
+/** @file
+ * driver for the LPC8 MRT, on the MRT model of the host simulation.
+ * @addtogroup Host
+ * @{
+ */
+module;
+#include <bit>
+#include <cstdint>
+module mrt_drv;
+import MRT;
+import sim;
+
+using namespace lpc865::MRT;
+
+void lpc865::Mrt::isr() {
+    uint32_t flags = in_.model->takeFlags();
+    while (flags) {
+        unsigned chan = std::countr_zero(flags);
+        flags &= flags - 1;
+        if (chan >= channels)
+            break;
+        ticks_[chan] = ticks_[chan] + 1;
+        if (hdl_[chan])
+            hdl_[chan]->post();
+    }
+}
+
+void lpc865::Mrt::startRepeat(unsigned chan, uint32_t interval, Handler &hdl) {
+    hdl_[chan] = &hdl;
+    ticks_[chan] = 0;
+    in_.model->start(chan, interval);
+}
+
+void lpc865::Mrt::stop(unsigned chan) {
+    in_.model->start(chan, 0);
+    hdl_[chan] = nullptr;
+}
+
+lpc865::Mrt::Mrt(Intgr const &in)
+    : in_{in}
+    , hdl_{}
+    , ticks_{}
+{
+    in_.model->attach(*this);
+}
+
+/** @}*/
@@ -0,0 +1,83 @@
+/** @file
+ * ARM NVIC driver, for the host build.
+ *
+ * @addtogroup Host
+ * @{
+ */
+
+module;
+#include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+export module nvic_drv;
+
+/** Exception number. The simulation delivers interrupts to the objects
+ * directly, so the numbers only serve as identifiers.
+ */
+export using Exception = unsigned;
+
+export namespace arm {
+
+/** The simulation has no concurrency, so interrupts need no masking. */
+inline void enable_irq() {}
+
+inline void disable_irq() {}
+
+inline void wfe(void) {}
+
+/** Start the cycle counter. The host counter runs anyway. */
+void startCycleCounter();
+
+/** Read the current value of the cycle counter.
+ * It counts down over 24 bits, like SysTick on the target, but in cycles of
+ * the time stamp counter of the host, which are about 0.3 ns on current x86
+ * processors. Elsewhere, it counts ns.
+ */
+inline uint32_t cycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+    return uint32_t(-__rdtsc()) & 0xFFFFFF;
+#else
+    auto ns = std::chrono::steady_clock::now().time_since_epoch() / std::chrono::nanoseconds(1);
+    return uint32_t(-ns) & 0xFFFFFF;
+#endif
+}
+
+/** Number of cycles elapsed between two readings of the cycle counter.
+ * Correct as long as less than 2^24 cycles have elapsed.
+ */
+inline uint32_t cycleDiff(uint32_t from, uint32_t to) {
+    return (from - to) & 0xFFFFFF;  // the counter counts down
+}
+
+
+/** Interrupt service object.
+ *
+ * The same interface as on the target. The peripheral models of the
+ * simulation call isr() of the object that the driver registered with them,
+ * so enabling, binding and priorities have no effect.
+ */
+class Interrupt {
+    Interrupt(Interrupt &&) =delete;
+protected:
+    ~Interrupt() =default;
+    Interrupt() =default;
+public:
+    typedef void (VectorTableEntry)();
+
+    virtual void isr() =0;
+
+    void enable(Exception) {}
+    void disable(Exception) {}
+    void insert(Exception) {}
+    bool bind(Exception) { return true; }
+
+    static void setPriority(Exception, uint8_t) {}
+};
+
+}
+
+//!@}
@@ -0,0 +1,30 @@
+/** @file
+ * LPC865 PINT driver, on the PINT model of the host simulation.
+ * @addtogroup Host
+ * @{
+ */
+module;
+#include <cstdint>
+module pint_drv;
+import PINT;
+import sim;
+
+using namespace lpc865::PINT;
+
+void lpc865::Pint::attach(unsigned num, uint8_t mode, arm::Interrupt &intr) {
+    in_.model->attach(num, intr);
+    enable(num, mode);
+}
+
+void lpc865::Pint::enable(unsigned num, uint8_t mode) {
+    in_.model->enable(num, mode);
+}
+
+lpc865::Pint::Pint(Intgr const &in)
+    : in_{in}
+{
+    for (unsigned num = 0; num < sim::PintModel::pins; ++num)
+        in_.model->enable(num, 0);
+}
+
+/** @}*/
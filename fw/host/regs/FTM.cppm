@@ -0,0 +1,26 @@
+/** @file
+ * Integration of the FTM timer in the host simulation.
+ *
+ * It takes the place of the module generated by sodaCat for the target, and
+ * connects the driver to its model instead of the registers.
+ *
+ * @addtogroup Host
+ * @{
+ */
+
+module;
+#include <cstdint>
+export module FTM;
+import sim;
+
+export namespace lpc865::FTM {
+
+/** Integration values. */
+struct Intgr {
+    sim::FtmModel *model;
+    uint8_t max_channel;    //!< Highest channel number
+};
+
+} // namespace
+
+//!@}
@@ -0,0 +1,25 @@
+/** @file
+ * Integration of the I2C controller in the host simulation.
+ *
+ * It takes the place of the module generated by sodaCat for the target, and
+ * connects the driver to its model instead of the registers.
+ *
+ * @addtogroup Host
+ * @{
+ */
+
+module;
+#include <cstdint>
+export module I2C;
+import sim;
+
+export namespace lpc865::I2C {
+
+/** Integration values. */
+struct Intgr {
+    sim::I2cModel *model;
+};
+
+} // namespace
+
+//!@}
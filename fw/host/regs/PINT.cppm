@@ -0,0 +1,25 @@
+/** @file
+ * Integration of the pin interrupt block in the host simulation.
+ *
+ * It takes the place of the module generated by sodaCat for the target, and
+ * connects the driver to its model instead of the registers.
+ *
+ * @addtogroup Host
+ * @{
+ */
+
+module;
+#include <cstdint>
+export module PINT;
+import sim;
+
+export namespace lpc865::PINT {
+
+/** Integration values. */
+struct Intgr {
+    sim::PintModel *model;
+};
+
+} // namespace
+
+//!@}
@@ -0,0 +1,27 @@
+/** @file
+ * Integration of the SRC4392 in the host simulation.
+ *
+ * It takes the place of the module generated by sodaCat for the target. The
+ * driver only needs the integration values, the chip itself is modeled on the
+ * SPI bus of the simulation.
+ *
+ * @addtogroup Host
+ * @{
+ */
+
+module;
+#include <cstdint>
+export module SRC4392;
+
+export namespace src4392::SRC4392 {
+
+/** Integration values. */
+struct Intgr {
+    uint8_t addr;           //!< Chip select number
+    uint8_t cpm;            //!< Control port mode
+    uint8_t src_present;    //!< The SRC is fitted
+};
+
+} // namespace
+
+//!@}
@@ -0,0 +1,25 @@
+/** @file
+ * Integration of the DMA controller in the host simulation.
+ *
+ * It takes the place of the module generated by sodaCat for the target. The
+ * DMA transfers of the SPI are part of its model, so the DMA driver isn't
+ * used, and this only satisfies its interface.
+ *
+ * @addtogroup Host
+ * @{
+ */
+
+module;
+#include <cstdint>
+export module SmartDMA;
+
+export namespace lpc865::SmartDMA {
+
+/** Integration values. */
+struct Intgr {
+    uint8_t max_channel;    //!< Highest channel number
+};
+
+} // namespace
+
+//!@}
@@ -0,0 +1,25 @@
+/** @file
+ * Integration of the wakeup timer in the host simulation.
+ *
+ * It takes the place of the module generated by sodaCat for the target, and
+ * connects the driver to its model instead of the registers.
+ *
+ * @addtogroup Host
+ * @{
+ */
+
+module;
+#include <cstdint>
+export module WKT;
+import sim;
+
+export namespace lpc865::WKT {
+
+/** Integration values. */
+struct Intgr {
+    sim::WktModel *model;
+};
+
+} // namespace
+
+//!@}
@@ -0,0 +1,385 @@
+/** @file
+ * Event driven simulation of the LPC865 peripherals, for the host build.
+ * @addtogroup Host
+ * @{
+ */
+module;
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+module sim;
+
+namespace {
+
+sim::Event *head = nullptr;     //!< Scheduled events, in the order of their time
+sim::Time clock = 0;
+sim::Cpu cpu{ 1000, 3000 };
+sim::Load usage{};
+
+constexpr sim::Time nsPerSecond = 1000000000;
+
+} // namespace
+
+sim::Time sim::now() {
+    return clock;
+}
+
+void sim::schedule(Event &e, Time at) {
+    cancel(e);
+    Event **pos = &head;
+    while (*pos && (*pos)->at_ <= at)
+        pos = &(*pos)->next_;
+    e.at_ = at;
+    e.next_ = *pos;
+    e.scheduled_ = true;
+    *pos = &e;
+}
+
+void sim::cancel(Event &e) {
+    if (!e.scheduled_)
+        return;
+    for (Event **pos = &head; *pos; pos = &(*pos)->next_) {
+        if (*pos == &e) {
+            *pos = e.next_;
+            break;
+        }
+    }
+    e.next_ = nullptr;
+    e.scheduled_ = false;
+}
+
+void sim::interrupt(arm::Interrupt &intr) {
+    clock += cpu.isrNs;
+    usage.busy += cpu.isrNs;
+    ++usage.isrs;
+    intr.isr();
+}
+
+void sim::setCpu(Cpu const &c) {
+    cpu = c;
+}
+
+sim::Load sim::load() {
+    return usage;
+}
+
+sim::Time sim::run(Time until) {
+    while (clock < until) {
+        if (head && head->at_ <= clock) {
+            Event &e = *head;
+            head = e.next_;
+            e.next_ = nullptr;
+            e.scheduled_ = false;
+            e.fire(e.at_);
+            continue;
+        }
+        // The handler sees the time at the end of its slot, so that what it
+        // starts doesn't overlap with its own execution.
+        clock += cpu.actNs;
+        if (Handler::poll_one()) {
+            usage.busy += cpu.actNs;
+            ++usage.acts;
+            continue;
+        }
+        clock -= cpu.actNs;
+        clock = head ? std::min(head->at_, until) : until;
+    }
+    return clock;
+}
+
+void sim::reset() {
+    while (head)
+        cancel(*head);
+    clock = 0;
+    usage = {};
+}
+
+void sim::Line::set(bool level, Time t) {
+    if (level == level_)
+        return;
+    level_ = level;
+    for (auto *l = listeners_; l; l = l->next_)
+        l->edge(level, t);
+}
+
+void sim::Line::connect(Listener &l) {
+    l.next_ = listeners_;
+    listeners_ = &l;
+}
+
+sim::PintModel::PintModel()
+    : pins_{}
+{
+}
+
+void sim::PintModel::connect(unsigned num, Line &line) {
+    pins_[num].line = &line;
+    line.connect(pins_[num]);
+}
+
+void sim::PintModel::attach(unsigned num, arm::Interrupt &intr) {
+    pins_[num].intr = &intr;
+}
+
+void sim::PintModel::enable(unsigned num, uint8_t mode) {
+    auto &p = pins_[num];
+    p.mode = mode;
+    if (p.active())
+        schedule(p, now());     // a level interrupt is taken right away
+    else
+        cancel(p);
+}
+
+/** True if the pin is at the active level of a level interrupt. */
+bool sim::PintModel::Pin::active() const {
+    if (!line)
+        return false;
+    return (mode == 4 && !line->level()) || (mode == 5 && line->level());
+}
+
+void sim::PintModel::Pin::edge(bool level, Time t) {
+    bool hit = false;
+    switch (mode) {
+    case 1: hit = level; break;
+    case 2: hit = !level; break;
+    case 3: hit = true; break;
+    case 4: hit = !level; break;
+    case 5: hit = level; break;
+    }
+    if (hit)
+        schedule(*this, t);
+}
+
+void sim::PintModel::Pin::fire(Time) {
+    if (!intr || mode == 0)
+        return;
+    ++raised;
+    interrupt(*intr);
+    // A level interrupt that is still enabled and active comes again.
+    if (active())
+        schedule(*this, now());
+}
+
+sim::FtmModel::FtmModel(uint32_t hz)
+    : hz_{hz}
+    , flags_{0}
+    , intr_{nullptr}
+    , chans_{}
+{
+    for (unsigned i = 0; i < channels; ++i) {
+        chans_[i].ftm = this;
+        chans_[i].num = uint8_t(i);
+    }
+}
+
+void sim::FtmModel::connect(unsigned ch, Line &line) {
+    line.connect(chans_[ch]);
+}
+
+void sim::FtmModel::configure(unsigned ch, uint8_t mode) {
+    chans_[ch].mode = mode;
+}
+
+uint16_t sim::FtmModel::count(Time t) const {
+    return uint16_t(t * hz_ / nsPerSecond);
+}
+
+void sim::FtmModel::compare(unsigned ch, uint16_t value) {
+    // The first tick at or after now whose count is the value
+    uint64_t tick = now() * hz_ / nsPerSecond;
+    tick += uint16_t(value - uint16_t(tick));
+    schedule(chans_[ch], Time((tick * nsPerSecond + hz_ - 1) / hz_));
+}
+
+uint32_t sim::FtmModel::takeFlags() {
+    return std::exchange(flags_, 0);
+}
+
+void sim::FtmModel::Chan::edge(bool level, Time t) {
+    // Modes capturePos, captureNeg and captureBoth of lpc865::Ftm
+    if ((mode == 1 && level) || (mode == 2 && !level) || mode == 3) {
+        value = ftm->count(t);
+        ++taken;
+    }
+}
+
+void sim::FtmModel::Chan::fire(Time) {
+    ftm->flags_ |= 1u << num;
+    if (ftm->intr_)
+        interrupt(*ftm->intr_);
+}
+
+sim::MrtModel::MrtModel(uint32_t hz)
+    : hz_{hz}
+    , flags_{0}
+    , intr_{nullptr}
+    , chans_{}
+{
+    for (unsigned i = 0; i < channels; ++i) {
+        chans_[i].mrt = this;
+        chans_[i].num = uint8_t(i);
+    }
+}
+
+void sim::MrtModel::start(unsigned chan, uint32_t interval) {
+    auto &c = chans_[chan];
+    c.period = Time(interval) * nsPerSecond / hz_;
+    if (c.period)
+        schedule(c, now() + c.period);
+    else
+        cancel(c);
+}
+
+uint32_t sim::MrtModel::takeFlags() {
+    return std::exchange(flags_, 0);
+}
+
+void sim::MrtModel::Chan::fire(Time t) {
+    schedule(*this, t + period);
+    mrt->flags_ |= 1u << num;
+    if (mrt->intr_)
+        interrupt(*mrt->intr_);
+}
+
+sim::WktModel::WktModel(uint32_t hz)
+    : hz_{hz}
+    , intr_{nullptr}
+{
+}
+
+void sim::WktModel::start(uint32_t count) {
+    schedule(*this, now() + Time(count) * nsPerSecond / hz_);
+}
+
+void sim::WktModel::fire(Time) {
+    if (intr_)
+        interrupt(*intr_);
+}
+
+sim::SpiModel::SpiModel()
+    : intr_{nullptr}
+    , devs_{}
+    , sel_{0}
+    , ins_{-1}
+    , extra_{0}
+    , read_{false}
+    , stats_{}
+{
+}
+
+void sim::SpiModel::command(uint8_t sel, int ins, uint8_t extra, bool read) {
+    sel_ = sel;
+    ins_ = ins;
+    extra_ = extra;
+    read_ = read;
+}
+
+void sim::SpiModel::start(uint8_t *buf, size_t size, Time ns, Time leadNs, Time byteNs) {
+    Time t0 = now();
+    if (busy())
+        ++stats_.overlaps;
+    unsigned selected = 0;
+    for (unsigned s = 0; s < selects; ++s)
+        if ((sel_ & (1u << s)) && devs_[s])
+            ++selected;
+    if (read_ && selected > 1)
+        ++stats_.contention;
+    for (unsigned s = 0; s < selects; ++s) {
+        auto *dev = devs_[s];
+        if (!(sel_ & (1u << s)) || !dev)
+            continue;
+        dev->select(t0);
+        Time t = t0 + leadNs;
+        if (ins_ >= 0) {
+            dev->exchange(uint8_t(ins_), t);
+            t += byteNs;
+        }
+        for (unsigned i = 0; i < extra_; ++i, t += byteNs)
+            dev->exchange(0x00, t);
+        for (size_t i = 0; i < size; ++i, t += byteNs) {
+            uint8_t miso = dev->exchange(buf[i], t);
+            if (read_)
+                buf[i] = selected > 1 ? uint8_t(buf[i] & miso) : miso;  // open drain like contention
+        }
+        dev->deselect(t0 + ns);
+    }
+    ++stats_.transfers;
+    stats_.bytes += size + commandBytes();
+    stats_.busy += ns;
+    schedule(*this, t0 + ns);
+}
+
+void sim::SpiModel::fire(Time) {
+    if (intr_)
+        interrupt(*intr_);
+}
+
+sim::I2cModel::I2cModel(uint32_t hz)
+    : byteNs_{9 * nsPerSecond / hz}     // 8 data bits and the acknowledge
+    , intr_{nullptr}
+    , head_{nullptr}
+    , tail_{nullptr}
+    , pos_{0}
+    , status_{}
+{
+}
+
+void sim::I2cModel::submit(Transaction &t) {
+    t.acked = false;
+    t.done = false;
+    t.next = nullptr;
+    if (tail_)
+        tail_->next = &t;
+    else
+        head_ = &t;
+    tail_ = &t;
+    if (head_ == &t) {
+        pos_ = 0;
+        schedule(*this, now() + byteNs_);
+    }
+}
+
+void sim::I2cModel::serve(bool ack) {
+    status_.pending = false;
+    if (head_ && pos_ == 0)
+        head_->acked = ack;
+}
+
+/** One byte time of the current transaction has passed. */
+void sim::I2cModel::fire(Time t) {
+    auto &tr = *head_;
+    bool stop = pos_ > tr.size || (pos_ > 0 && !tr.acked);
+    if (stop) {
+        status_ = { false, true, status_.state, 0 };
+        if (intr_)
+            interrupt(*intr_);
+        tr.done = true;
+        next(t);
+        return;
+    }
+    if (pos_ == 0)
+        status_ = { true, false, address, uint8_t(tr.addr << 1 | tr.read) };
+    else if (tr.read)
+        status_ = { true, false, transmit, 0xFF };
+    else
+        status_ = { true, false, receive, tr.data[pos_ - 1] };
+    if (intr_)
+        interrupt(*intr_);
+    if (pos_ > 0 && tr.read)
+        tr.data[pos_ - 1] = status_.data;
+    ++pos_;
+    schedule(*this, t + byteNs_);
+}
+
+/** Go on with the next transaction. */
+void sim::I2cModel::next(Time t) {
+    head_ = head_->next;
+    if (!head_)
+        tail_ = nullptr;
+    pos_ = 0;
+    if (head_)
+        schedule(*this, t + byteNs_);
+}
+
+/** @}*/
@@ -0,0 +1,434 @@
+/** @file
+ * Event driven simulation of the LPC865 peripherals, for the host build.
+ *
+ * @addtogroup Host
+ * @{
+ */
+
+module;
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+export module sim;
+import handler;
+import nvic_drv;
+
+/** Simulation kernel and peripheral models.
+ *
+ * The host build runs the firmware modules unchanged against these models,
+ * instead of the registers of the LPC865. Simulated time advances in ns, from
+ * one event to the next. The models schedule events for what the hardware
+ * does on its own, like the end of an SPI transfer, and call the isr() of the
+ * driver object when the hardware would raise its interrupt.
+ *
+ * The CPU is modeled as taking a fixed time per interrupt service routine and
+ * per handler dispatch, see Cpu. A handler runs as a whole at the start of
+ * its time slot, and the simulated clock then moves past it. Events that fall
+ * into the slot are handled after it, with their own timestamps, so the
+ * captures and transfers keep their exact timing, but an interrupt service
+ * routine can't preempt a handler. This is close to the target, where they
+ * only take a timestamp and post a handler.
+ *
+ * There is no concurrency, so masking interrupts is a no-op.
+ */
+export namespace sim {
+
+/** Simulated time in ns. */
+using Time = uint64_t;
+
+/** Something that happens at a point in simulated time. */
+class Event {
+public:
+    /** Called when the simulated time has reached the event. */
+    virtual void fire(Time t) =0;
+
+    bool scheduled() const { return scheduled_; }
+
+    /** Time the event is scheduled for. */
+    Time at() const { return at_; }
+
+protected:
+    ~Event() =default;
+
+private:
+    friend void schedule(Event &, Time);
+    friend void cancel(Event &);
+    friend Time run(Time);
+
+    Time at_ = 0;
+    Event *next_ = nullptr;
+    bool scheduled_ = false;
+};
+
+/** CPU time model, in ns. */
+struct Cpu {
+    uint32_t isrNs;     //!< Interrupt entry, service routine and exit
+    uint32_t actNs;     //!< Handler dispatch and act()
+};
+
+/** CPU load since the last reset(). */
+struct Load {
+    Time busy;          //!< Time spent in service routines and handlers
+    uint64_t isrs;      //!< Service routines run
+    uint64_t acts;      //!< Handlers dispatched
+};
+
+/** Current simulated time. */
+Time now();
+
+/** Schedule an event, or move it if it is scheduled already.
+ * Events at the same time fire in the order they were scheduled.
+ */
+void schedule(Event &e, Time at);
+
+/** Remove an event from the schedule. Nothing happens if it isn't scheduled. */
+void cancel(Event &e);
+
+/** Run the service routine of an interrupt, and charge it to the CPU. */
+void interrupt(arm::Interrupt &intr);
+
+/** Set the CPU time model. */
+void setCpu(Cpu const &cpu);
+
+/** Get the CPU load. */
+Load load();
+
+/** Run the events and handlers up to a point in time.
+ * Handlers that are still ready then, and events due then, are left for the
+ * next call.
+ * @return The simulated time, which is until
+ */
+Time run(Time until);
+
+/** Drop all events, and start again at time 0. */
+void reset();
+
+/** Scope of a simulation run.
+ * It resets the simulation when it starts and when it ends. The models of a
+ * run must be declared after it, so that their events are dropped before
+ * they are destroyed.
+ */
+struct Session {
+    Session() { reset(); }
+    ~Session() { reset(); }
+    Session(Session const &) =delete;
+    Session &operator=(Session const &) =delete;
+};
+
+/** Digital signal between a model and another. */
+class Line {
+public:
+    /** Observer of the edges of a line. */
+    class Listener {
+    public:
+        virtual void edge(bool level, Time t) =0;
+    protected:
+        ~Listener() =default;
+    private:
+        friend class Line;
+        Listener *next_ = nullptr;
+    };
+
+    bool level() const { return level_; }
+
+    /** Change the level, and tell the listeners if it changes. */
+    void set(bool level, Time t);
+
+    /** Add a listener. Each listener can observe one line. */
+    void connect(Listener &l);
+
+    explicit Line(bool level = true) : level_{level} {}
+
+private:
+    bool level_;
+    Listener *listeners_ = nullptr;
+};
+
+/** Pin interrupt model.
+ * The modes are the ones of lpc865::Pint. A level interrupt is raised again
+ * as long as the line is at the active level and the interrupt is enabled,
+ * like the hardware does.
+ */
+class PintModel {
+public:
+    static constexpr unsigned pins = 8;
+
+    void connect(unsigned num, Line &line);
+    void attach(unsigned num, arm::Interrupt &intr);
+    void enable(unsigned num, uint8_t mode);
+
+    /** Interrupts raised per pin. */
+    uint64_t raised(unsigned num) const { return pins_[num].raised; }
+
+    PintModel();
+
+private:
+    struct Pin : Line::Listener, Event {
+        void edge(bool level, Time t) override;
+        void fire(Time t) override;
+        bool active() const;
+
+        Line *line = nullptr;
+        arm::Interrupt *intr = nullptr;
+        uint8_t mode = 0;
+        uint64_t raised = 0;
+    };
+
+    std::array<Pin, pins> pins_;
+};
+
+/** FTM model, for the counter, the input captures and the compare interrupts.
+ * The counter runs freely over 16 bits. Each channel captures the count on
+ * the edges selected by its mode, which are the capture modes of lpc865::Ftm.
+ * A compare raises the interrupt once, when the counter reaches its value.
+ */
+class FtmModel {
+public:
+    static constexpr unsigned channels = 8;
+
+    void connect(unsigned ch, Line &line);
+    void configure(unsigned ch, uint8_t mode);
+    void attach(arm::Interrupt &intr) { intr_ = &intr; }
+
+    /** Raise the interrupt of a channel once, when the counter next reaches
+     * a value.
+     */
+    void compare(unsigned ch, uint16_t value);
+
+    /** Fetch and clear the compare flags, bit n for channel n. */
+    uint32_t takeFlags();
+
+    uint16_t count() const { return count(now()); }
+    uint16_t count(Time t) const;
+
+    /** The capture register of a channel. */
+    uint16_t volatile &capture(unsigned ch) { return chans_[ch].value; }
+
+    /** Captures taken per channel. */
+    uint64_t captures(unsigned ch) const { return chans_[ch].taken; }
+
+    /** @param hz Counter clock */
+    explicit FtmModel(uint32_t hz);
+
+private:
+    struct Chan : Line::Listener, Event {
+        void edge(bool level, Time t) override;
+        void fire(Time t) override;
+
+        FtmModel *ftm = nullptr;
+        uint8_t num = 0;
+        uint8_t mode = 0;
+        uint16_t volatile value = 0xFFFF;
+        uint64_t taken = 0;
+    };
+
+    uint32_t hz_;
+    uint32_t flags_;
+    arm::Interrupt *intr_;
+    std::array<Chan, channels> chans_;
+};
+
+/** MRT model, with channels in repeat mode. */
+class MrtModel {
+public:
+    static constexpr unsigned channels = 4;
+
+    void attach(arm::Interrupt &intr) { intr_ = &intr; }
+
+    /** Start a channel, or stop it with interval 0.
+     * @param interval Period in system clock cycles
+     */
+    void start(unsigned chan, uint32_t interval);
+
+    /** Fetch and clear the interrupt flags, bit n for channel n. */
+    uint32_t takeFlags();
+
+    /** @param hz System clock */
+    explicit MrtModel(uint32_t hz);
+
+private:
+    struct Chan : Event {
+        void fire(Time t) override;
+
+        MrtModel *mrt = nullptr;
+        Time period = 0;
+        uint8_t num = 0;
+    };
+
+    uint32_t hz_;
+    uint32_t flags_;
+    arm::Interrupt *intr_;
+    std::array<Chan, channels> chans_;
+};
+
+/** WKT model, a one-shot down counter. */
+class WktModel : Event {
+public:
+    void attach(arm::Interrupt &intr) { intr_ = &intr; }
+
+    /** Start counting down from count, which raises the interrupt at 0. */
+    void start(uint32_t count);
+
+    /** @param hz Counter clock */
+    explicit WktModel(uint32_t hz);
+
+private:
+    void fire(Time t) override;
+
+    uint32_t hz_;
+    arm::Interrupt *intr_;
+};
+
+/** Target on an SPI bus. */
+class SpiDevice {
+public:
+    /** The target select has been asserted. */
+    virtual void select(Time t) =0;
+
+    /** Exchange a byte.
+     * @param mosi Byte sent by the controller
+     * @param t Time of the first clock edge of the byte
+     * @return Byte sent by the target
+     */
+    virtual uint8_t exchange(uint8_t mosi, Time t) =0;
+
+    /** The target select has been deasserted. */
+    virtual void deselect(Time t) =0;
+
+protected:
+    ~SpiDevice() =default;
+};
+
+/** SPI controller model, including the DMA that feeds it.
+ * A transfer exchanges its bytes with the selected targets when it starts,
+ * each with the time it would be clocked, and raises the interrupt when it
+ * ends. The DMA has moved the data by then, so the driver sees the same as on
+ * the target.
+ */
+class SpiModel : Event {
+public:
+    static constexpr unsigned selects = 4;
+
+    /** Bus statistics. */
+    struct Stats {
+        uint64_t transfers;     //!< Transfers run
+        uint64_t bytes;         //!< Bytes clocked, including command bytes
+        Time busy;              //!< Time with a target selected, including the delays
+        uint64_t contention;    //!< Reads with more than one target selected
+        uint64_t overlaps;      //!< Transfers started while the bus was busy
+    };
+
+    void attach(arm::Interrupt &intr) { intr_ = &intr; }
+
+    /** Connect a target to a target select. */
+    void connect(unsigned sel, SpiDevice &dev) { devs_[sel] = &dev; }
+
+    /** Set the command phase of the next transfer.
+     * @param sel Target selects, bit n for select n
+     * @param ins Instruction byte, or -1 if none
+     * @param extra Address and dummy bytes following the instruction
+     * @param read The data phase reads
+     */
+    void command(uint8_t sel, int ins, uint8_t extra, bool read);
+
+    /** Start a transfer of the data phase.
+     * @param buf Data, which receives the read data
+     * @param size Bytes in the data phase
+     * @param ns Duration of the transfer, including the command and delays
+     * @param leadNs Time from the select to the first clock edge
+     * @param byteNs Time per byte
+     */
+    void start(uint8_t *buf, size_t size, Time ns, Time leadNs, Time byteNs);
+
+    /** Bytes in the command phase set by command(). */
+    unsigned commandBytes() const { return (ins_ >= 0) + extra_; }
+
+    bool busy() const { return scheduled(); }
+
+    Stats const &stats() const { return stats_; }
+
+    SpiModel();
+
+private:
+    void fire(Time t) override;
+
+    arm::Interrupt *intr_;
+    std::array<SpiDevice *, selects> devs_;
+    uint8_t sel_;
+    int ins_;
+    uint8_t extra_;
+    bool read_;
+    Stats stats_;
+};
+
+/** I2C controller on the host side, talking to the I2C target of the LPC865.
+ * The transactions are queued and run one after another, one byte per
+ * interrupt, at the byte time of the bus. The target driver sees the states of
+ * the target mode of the LPC8 I2C block.
+ */
+class I2cModel : Event {
+public:
+    /** States of the target, like the SLVSTATE field of the LPC8 I2C. */
+    enum State : uint8_t {
+        address,                //!< Address byte received, SLVDAT holds it
+        receive,                //!< Data byte received, SLVDAT holds it
+        transmit,               //!< Data byte to be sent, to be put in SLVDAT
+    };
+
+    /** What the target driver sees in its service routine. */
+    struct Status {
+        bool pending;           //!< The target needs service, see state
+        bool deselected;        //!< The transaction has ended
+        State state;
+        uint8_t data;           //!< The byte received
+    };
+
+    /** A transaction of the host. */
+    struct Transaction {
+        uint8_t addr;           //!< 7-bit target address
+        bool read;
+        uint8_t size;           //!< Bytes to write or read
+        std::array<uint8_t, 64> data;
+        bool acked;             //!< The target has acknowledged its address
+        bool done;              //!< The transaction has ended
+        Transaction *next;
+    };
+
+    void attach(arm::Interrupt &intr) { intr_ = &intr; }
+
+    /** Queue a transaction. It must stay alive until it is done. */
+    void submit(Transaction &t);
+
+    /** Status of the target, for its service routine. */
+    Status const &status() const { return status_; }
+
+    /** The target has served the pending state.
+     * @param ack False to refuse the address
+     */
+    void serve(bool ack = true);
+
+    /** The target puts the byte to be sent. */
+    void reply(uint8_t data) { status_.data = data; }
+
+    /** The target has seen the end of the transaction. */
+    void clearDeselect() { status_.deselected = false; }
+
+    /** @param hz Bus clock */
+    explicit I2cModel(uint32_t hz);
+
+private:
+    void fire(Time t) override;
+    void next(Time t);
+
+    Time byteNs_;
+    arm::Interrupt *intr_;
+    Transaction *head_;
+    Transaction *tail_;
+    unsigned pos_;              //!< Bytes of the current transaction done, 0 for the address
+    Status status_;
+};
+
+} // namespace
+
+//!@}
@@ -0,0 +1,79 @@
+/** @file
+ * SPI controller driver, on the SPI model of the host simulation.
+ * @addtogroup Host
+ * @{
+ */
+module;
+#include <cstddef>
+#include <cstdint>
+module spi_drv;
+import SPI;
+import sim;
+
+using namespace lpc865::SPI;
+
+/** The model takes the delays from the plan of each transfer. */
+void lpc865::Spi::apply(Plan const &p) {
+    applied_ = &p;
+}
+
+bool lpc865::Spi::target(Parameters const &par, Handler *hdl, uint32_t speed) {
+    if (par.sel & 0xF0)
+        return false;
+    hdl_ = hdl;
+    uint32_t limit = speedHz(par.cmd.maxHz);
+    if (speed && (!limit || speed < limit))
+        limit = speed;
+    unsigned rd = par.cmd.read;
+    if (limit != limits_[rd]) {
+        limits_[rd] = limit;
+        plans_[rd] = plan(clk_, limit, rd);
+        applied_ = nullptr;
+    }
+    if (applied_ != &plans_[rd])
+        apply(plans_[rd]);
+    // The command phase is sent ahead of the data, like a controller with a
+    // command phase would do.
+    unsigned extra = par.cmd.addb + (par.cmd.dummy + par.cmd.mclks + 7) / 8;
+    in_.model->command(par.sel, par.noins ? -1 : int(par.cmd.ins), uint8_t(extra), par.cmd.read);
+    return true;
+}
+
+ptrdiff_t lpc865::Spi::transfer(void *buf, size_t size) {
+    if (in_.model->busy())
+        return -1;
+    Plan const &p = *applied_;
+    sim::Time period = 1000000000u / p.hz;
+    in_.model->start(static_cast<uint8_t *>(buf), size, p.ns(in_.model->commandBytes() + size),
+                     (p.pre + 1) * period, 8 * period);
+    return 0;
+}
+
+auto lpc865::Spi::status() const -> Status {
+    return in_.model->busy() ? busy : idle;
+}
+
+lpc865::Spi::Spi(Intgr const &in, Dma *dma, Clocking const &clk)
+    : Handler{readySet}
+    , in_{in}
+    , dma_{dma}
+    , hdl_{nullptr}
+    , clk_{clk}
+    , limits_{}
+    , plans_{ plan(clk, 0, false), plan(clk, 0, true) }
+    , applied_{nullptr}
+{
+    apply(plans_[1]);
+    in_.model->attach(*this);
+}
+
+void lpc865::Spi::act() {
+}
+
+// This gets called when the model has completed a transfer.
+void lpc865::Spi::isr() {
+    if (hdl_)
+        hdl_->post();
+}
+
+/** @}*/
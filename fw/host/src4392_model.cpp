@@ -0,0 +1,260 @@
+/** @file
+ * Behavioural model of the SRC4392 control port, for the host build.
+ * @addtogroup Host
+ * @{
+ */
+module;
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+module src4392_model;
+
+namespace {
+
+constexpr uint8_t pageReg = 0x7F;
+constexpr uint8_t status1 = 0x13;
+constexpr uint8_t status2 = 0x14;
+constexpr uint8_t mask1 = 0x16;
+constexpr uint8_t mask2 = 0x17;
+constexpr uint8_t mode1 = 0x18;
+
+// Interrupt modes of each source in registers 0x18..0x1A
+constexpr uint8_t modeRising = 0;
+constexpr uint8_t modeFalling = 1;
+constexpr uint8_t modeLevel = 2;
+
+constexpr uint16_t events = 1u << sim::Src4392Model::srcBlockStart | 1u << sim::Src4392Model::srcQChange;
+
+/** Sources of status register 1 in the low nibble, of register 2 above. */
+constexpr unsigned sourcesOf1 = 4;
+
+/** Addresses of pages 1 and 2 that hold channel status or user data. */
+constexpr bool mapped(uint8_t addr) {
+    return addr < 0x30 || (addr >= 0x40 && addr < 0x70);
+}
+
+} // namespace
+
+int64_t sim::Src4392Model::Blocks::index(Time t) const {
+    if (period == 0 || t < first)
+        return -1;
+    return int64_t((t - first) / period);
+}
+
+void sim::Src4392Model::Blocks::fire(Time t) {
+    ++count;
+    schedule(*this, t + period);
+    (chip->*flip)(t);
+}
+
+sim::Src4392Model::Src4392Model()
+    : irq{true}
+    , page0_{}
+    , rx_{}
+    , rxNext_{}
+    , tx_{}
+    , page_{0}
+    , latched_{0}
+    , conditions_{0}
+    , pos_{0}
+    , addr_{0}
+    , read_{false}
+    , accessPage_{0}
+    , firstData_{0}
+    , lastData_{0}
+    , blockIndex_{-1}
+    , blockBytes_{0}
+    , violations_{}
+    , traffic_{}
+{
+    rxBlock_.chip = this;
+    rxBlock_.flip = &Src4392Model::rxFlip;
+    txBlock_.chip = this;
+    txBlock_.flip = &Src4392Model::txFlip;
+}
+
+void sim::Src4392Model::startReceiver(Time first, Time period) {
+    rxBlock_.first = first;
+    rxBlock_.period = period;
+    blockIndex_ = -1;
+    blockBytes_ = 0;
+    schedule(rxBlock_, first);
+}
+
+void sim::Src4392Model::stopReceiver() {
+    cancel(rxBlock_);
+    rxBlock_.period = 0;
+}
+
+void sim::Src4392Model::startTransmitter(Time first, Time period) {
+    txBlock_.first = first;
+    txBlock_.period = period;
+    schedule(txBlock_, first);
+}
+
+void sim::Src4392Model::receive(std::span<uint8_t const, bufferSize> data) {
+    std::ranges::copy(data, rxNext_.begin());
+}
+
+void sim::Src4392Model::rxFlip(Time t) {
+    rx_ = rxNext_;
+    raise(srcBlockStart, t);
+}
+
+/** The transmitter takes the buffer as written, there is nothing to model. */
+void sim::Src4392Model::txFlip(Time) {
+}
+
+uint8_t sim::Src4392Model::mode(Source src) const {
+    return (page0_[mode1 + src / 4] >> (2 * (src % 4))) & 0x03;
+}
+
+/** Status bits, bit n for Source n. */
+uint16_t sim::Src4392Model::status() const {
+    uint16_t level = 0;
+    for (unsigned s = 0; s < sourceCount; ++s)
+        if (!(events & (1u << s)) && mode(Source(s)) == modeLevel)
+            level |= 1u << s;
+    return latched_ | (conditions_ & level);
+}
+
+/** Drive the interrupt output from the status. */
+void sim::Src4392Model::update(Time t) {
+    uint16_t mask = page0_[mask1] | page0_[mask2] << sourcesOf1;
+    irq.set(!(status() & mask), t);
+}
+
+void sim::Src4392Model::raise(Source src, Time t) {
+    latched_ |= 1u << src;
+    update(t);
+}
+
+void sim::Src4392Model::condition(Source src, bool active, Time t) {
+    uint16_t bit = 1u << src;
+    bool was = conditions_ & bit;
+    conditions_ = active ? conditions_ | bit : conditions_ & ~bit;
+    if (active != was) {
+        uint8_t m = mode(src);
+        if ((m == modeRising && active) || (m == modeFalling && !active))
+            latched_ |= bit;
+    }
+    update(t);
+}
+
+uint8_t sim::Src4392Model::read(uint8_t addr, Time t) {
+    if (addr == pageReg)
+        return page_;
+    switch (page_) {
+    case 0:
+        if (addr == status1 || addr == status2) {
+            unsigned shift = addr == status1 ? 0 : sourcesOf1;
+            uint16_t bits = addr == status1 ? 0x000F : 0x01F0;
+            uint8_t value = uint8_t((status() & bits) >> shift);
+            latched_ &= ~bits;
+            ++traffic_.statusReads;
+            update(t);
+            return value;
+        }
+        return page0_[addr];
+    case 1:
+        return addr < bufferSize ? rx_[addr] : 0;
+    case 2:
+        return addr < bufferSize ? tx_[addr] : 0;
+    default:
+        return 0;
+    }
+}
+
+void sim::Src4392Model::write(uint8_t addr, uint8_t value, Time t) {
+    if (addr == pageReg) {
+        page_ = value;
+        if (value > 2)
+            ++violations_.badPage;
+        return;
+    }
+    switch (page_) {
+    case 0:
+        // The read-only registers ignore writes, like those of the chip.
+        if (addr == 0x02 || addr == 0x0A || (addr >= 0x12 && addr <= 0x15)
+            || (addr >= 0x1F && addr <= 0x2C) || addr >= 0x32)
+            return;
+        page0_[addr] = value;
+        if (addr >= mask1 && addr <= mode1 + 2)
+            update(t);
+        return;
+    case 1:
+        ++violations_.readOnly;
+        return;
+    case 2:
+        if (!mapped(addr))
+            ++violations_.unmapped;
+        else
+            tx_[addr] = value;
+        return;
+    default:
+        return;
+    }
+}
+
+/** Count a byte in the block interval it falls into. */
+void sim::Src4392Model::account(Time t) {
+    ++traffic_.bytes;
+    int64_t k = rxBlock_.index(t);
+    if (k < 0)
+        return;
+    if (k != blockIndex_) {
+        if (blockIndex_ >= 0) {
+            ++traffic_.blocks;
+            traffic_.maxBlockBytes = std::max(traffic_.maxBlockBytes, blockBytes_);
+        }
+        blockIndex_ = k;
+        blockBytes_ = 0;
+    }
+    ++blockBytes_;
+}
+
+void sim::Src4392Model::select(Time) {
+    pos_ = 0;
+    ++traffic_.transfers;
+}
+
+uint8_t sim::Src4392Model::exchange(uint8_t mosi, Time t) {
+    account(t);
+    unsigned pos = pos_++;
+    if (pos == 0) {
+        addr_ = mosi & 0x7F;
+        read_ = mosi & 0x80;
+        return 0;
+    }
+    if (pos == 1)
+        return 0;           // dummy byte
+    ++traffic_.dataBytes;
+    if (pos == 2) {
+        accessPage_ = page_;
+        firstData_ = t;
+    }
+    lastData_ = t;
+    if (addr_ > pageReg) {
+        ++violations_.overrun;
+        return 0;
+    }
+    uint8_t addr = addr_++;
+    if (read_)
+        return read(addr, t);
+    write(addr, mosi, t);
+    return 0;
+}
+
+void sim::Src4392Model::deselect(Time) {
+    if (pos_ < 3) {
+        ++violations_.truncated;
+        return;
+    }
+    if (accessPage_ == 1 && read_ && rxBlock_.index(firstData_) != rxBlock_.index(lastData_))
+        ++violations_.rxStraddles;
+    if (accessPage_ == 2 && !read_ && txBlock_.index(firstData_) != txBlock_.index(lastData_))
+        ++violations_.txStraddles;
+}
+
+/** @}*/
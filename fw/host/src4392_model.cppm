@@ -0,0 +1,197 @@
+/** @file
+ * Behavioural model of the SRC4392 control port, for the host build.
+ *
+ * @addtogroup Host
+ * @{
+ */
+
+module;
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+export module src4392_model;
+import sim;
+
+export namespace sim {
+
+/** SRC4392 as a target on the SPI bus of the simulation.
+ *
+ * The control port protocol is modeled as in the data sheet: each transfer
+ * starts with an instruction byte holding the register address, with the MSB
+ * set for reads, followed by a dummy byte. The data bytes then go to or come
+ * from consecutive registers. Register 0x7F selects the page on all pages.
+ * Page 0 holds the control and status registers, page 1 the channel status
+ * (0x00..0x2F) and user data (0x40..0x6F) of the receiver, and page 2 those of
+ * the transmitter.
+ *
+ * Pages 1 and 2 are double buffered. The receiver buffer flips at each
+ * received block start, and then holds the block that has just ended. The
+ * transmitter buffer flips at each transmitted block start. The intervals
+ * between the flips are computed from the block timing, and each byte is
+ * placed by its own time, so a read or write that straddles a flip is found
+ * exactly. Accesses that break the protocol are counted as violations.
+ *
+ * The receiver status registers 0x13 and 0x14 are modeled with their
+ * interrupt masks (0x16, 0x17) and modes (0x18..0x1A). Block starts and
+ * Q-subcode changes are events, whose status bit is set when they occur.
+ * The other sources are conditions. In the edge modes, the status bit is set
+ * on the selected transition of the condition. In the level mode, it reads as
+ * the condition itself. Reading a status register clears the bits it has set.
+ * The interrupt output is active low while a status bit that isn't masked is
+ * set.
+ *
+ * The SPI model applies the bytes of a transfer when it starts, each with the
+ * time it is clocked. Events of the chip that fall into a transfer are thus
+ * seen after it, as if the transfer had been a little earlier.
+ */
+class Src4392Model : public SpiDevice {
+public:
+    /** Interrupt sources, in the bit order of status registers 0x13 and 0x14. */
+    enum Source : uint8_t {
+        srcBlockStart,          //!< RBTI, event
+        srcQChange,             //!< QCHG, event
+        srcUnlock,              //!< UNLOCK, condition
+        srcQCrc,                //!< QCRC, condition
+        srcCsCrc,               //!< CSCRC, condition
+        srcParity,              //!< PARITY, condition
+        srcValidity,            //!< VBIT, condition
+        srcBiphase,             //!< BPERR, condition
+        srcSlip,                //!< OSLIP, condition
+        sourceCount
+    };
+
+    /** Protocol violations, counted per kind. */
+    struct Violations {
+        uint64_t truncated;     //!< Transfers without a data byte
+        uint64_t overrun;       //!< Data bytes past register 0x7F
+        uint64_t badPage;       //!< Page register set to a page that doesn't exist
+        uint64_t readOnly;      //!< Writes to page 1, which the receiver owns
+        uint64_t unmapped;      //!< Writes to unused addresses of pages 1 and 2
+        uint64_t rxStraddles;   //!< Page 1 reads that straddle a receiver buffer flip
+        uint64_t txStraddles;   //!< Page 2 writes that straddle a transmitter buffer flip
+
+        uint64_t total() const {
+            return truncated + overrun + badPage + readOnly + unmapped + rxStraddles + txStraddles;
+        }
+    };
+
+    /** Traffic of the chip. */
+    struct Traffic {
+        uint64_t transfers;     //!< Transfers with the chip selected
+        uint64_t bytes;         //!< Bytes clocked, including instruction and dummy bytes
+        uint64_t dataBytes;     //!< Bytes of the data phases
+        uint64_t blocks;        //!< Received blocks over which the bytes per block are taken
+        uint64_t maxBlockBytes; //!< Most bytes clocked in the interval of one received block
+        uint64_t statusReads;   //!< Reads of receiver status register 1 or 2
+    };
+
+    /** Size of the buffers of pages 1 and 2, including the unused addresses. */
+    static constexpr size_t bufferSize = 0x70;
+
+    void select(Time t) override;
+    uint8_t exchange(uint8_t mosi, Time t) override;
+    void deselect(Time t) override;
+
+    /** Start receiving blocks.
+     * @param first Time of the first block start
+     * @param period Block period, 192 samples at the received sampling rate
+     */
+    void startReceiver(Time first, Time period);
+
+    /** Stop receiving blocks, as when the receiver has lost its lock. */
+    void stopReceiver();
+
+    /** Set the transmitter block timing, for the flips of page 2.
+     * @param first Time of the first block start
+     * @param period Block period, 192 samples at the transmitted sampling rate
+     */
+    void startTransmitter(Time first, Time period);
+
+    /** Set the channel status and user data of the block being received,
+     * which becomes readable on page 1 after the next block start.
+     * @param data Page 1 addresses 0x00..0x6F
+     */
+    void receive(std::span<uint8_t const, bufferSize> data);
+
+    /** Page 2 addresses 0x00..0x6F as last written. */
+    std::span<uint8_t const, bufferSize> transmitted() const { return tx_; }
+
+    /** Signal an event. */
+    void raise(Source src, Time t);
+
+    /** Set the state of a condition. */
+    void condition(Source src, bool active, Time t);
+
+    /** Set the non-PCM detection status, register 0x12. */
+    void nonPcm(uint8_t status) { page0_[0x12] = status; }
+
+    /** A page 0 register as last written. */
+    uint8_t reg(uint8_t addr) const { return page0_[addr]; }
+
+    /** Page selected by the last write of the page register. */
+    uint8_t page() const { return page_; }
+
+    /** Receiver block starts so far. */
+    uint64_t rxBlocks() const { return rxBlock_.count; }
+
+    Violations const &violations() const { return violations_; }
+    Traffic const &traffic() const { return traffic_; }
+
+    /** The interrupt output, active low. */
+    Line irq;
+
+    Src4392Model();
+
+private:
+    /** Periodic block starts of the receiver or the transmitter. */
+    struct Blocks : Event {
+        void fire(Time t) override;
+
+        /** Index of the interval a time falls into, -1 before the first block. */
+        int64_t index(Time t) const;
+
+        Src4392Model *chip = nullptr;
+        void (Src4392Model::*flip)(Time) = nullptr;
+        Time first = 0;
+        Time period = 0;
+        uint64_t count = 0;
+    };
+
+    void rxFlip(Time t);
+    void txFlip(Time t);
+    uint8_t mode(Source src) const;
+    uint16_t status() const;
+    void update(Time t);
+    uint8_t read(uint8_t addr, Time t);
+    void write(uint8_t addr, uint8_t value, Time t);
+    void account(Time t);
+
+    std::array<uint8_t, 0x80> page0_;
+    std::array<uint8_t, bufferSize> rx_;            //!< Page 1 as read, the block before the last block start
+    std::array<uint8_t, bufferSize> rxNext_;        //!< The block being received
+    std::array<uint8_t, bufferSize> tx_;
+    uint8_t page_;
+    uint16_t latched_;          //!< Status bits set by events and edges, bit n for Source n
+    uint16_t conditions_;       //!< Current state of the conditions, bit n for Source n
+    Blocks rxBlock_;
+    Blocks txBlock_;
+
+    // The transfer in progress
+    unsigned pos_;              //!< Bytes of the transfer so far
+    uint8_t addr_;              //!< Register of the next data byte
+    bool read_;
+    uint8_t accessPage_;        //!< Page at the start of the data phase
+    Time firstData_;            //!< Time of the first data byte
+    Time lastData_;             //!< Time of the last data byte
+
+    int64_t blockIndex_;        //!< Receiver block the byte count is for
+    uint64_t blockBytes_;       //!< Bytes clocked in that block
+
+    Violations violations_;
+    Traffic traffic_;
+};
+
+} // namespace
+
+//!@}
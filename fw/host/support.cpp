@@ -0,0 +1,31 @@
+/** @file
+ * Board functions of the host build.
+ * @addtogroup Host
+ * @{
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+
+/** The log goes to stderr, where it doesn't mix with the results. It is
+ * only written if the environment variable AES42HAT_LOG is set, as the
+ * channels log every transfer sequence.
+ */
+void print(std::string_view s) {
+    static bool const enabled = std::getenv("AES42HAT_LOG") != nullptr;
+    if (enabled)
+        std::fwrite(s.data(), 1, s.size(), stderr);
+}
+
+bool activityLED = false;
+bool requestLine = false;
+
+void setActivityLED(bool act) {
+    activityLED = act;
+}
+
+void setRequestLine(bool active) {
+    requestLine = active;
+}
+
+/** @}*/
@@ -0,0 +1,292 @@
+/** @file
+ * Test of the SPI driver, the SPI queue and the SRC4392 driver against the
+ * SPI model, with targets that record what they see.
+ */
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <span>
+#include <vector>
+#include "check.h"
+
+import handler;
+import sim;
+import SPI;
+import SRC4392;
+import spi_drv;
+import spi_queue;
+import src4392_drv;
+import utility;
+
+namespace {
+
+/** A target that records the bytes of each selection, and answers reads
+ * with the low byte of the byte time.
+ */
+class Recorder : public sim::SpiDevice {
+public:
+    struct Frame {
+        std::vector<uint8_t> mosi;
+        sim::Time start;
+        sim::Time end;
+    };
+
+    void select(sim::Time t) override {
+        frames.push_back({ {}, t, 0 });
+    }
+
+    uint8_t exchange(uint8_t mosi, sim::Time) override {
+        auto &f = frames.back();
+        f.mosi.push_back(mosi);
+        return uint8_t(0xA0 + f.mosi.size());
+    }
+
+    void deselect(sim::Time t) override {
+        frames.back().end = t;
+    }
+
+    std::vector<Frame> frames;
+};
+
+struct Done : Handler {
+    Done() : Handler{readySet} {}
+    void act() override { ++count; }
+    unsigned count = 0;
+};
+
+constexpr lpc865::Spi::Clocking clocking{ 60000000, 30000000, 60, 50, 50, 100 };
+
+void testBatch() {
+    sim::Session session;
+    sim::SpiModel bus;
+    Recorder chip;
+    bus.connect(0, chip);
+    lpc865::SPI::Intgr spiIn{ &bus };
+    lpc865::Spi spi{ spiIn, nullptr, clocking };
+    lpc865::SpiQueue spiq{ spi };
+    Done done;
+    src4392::Src4392 src{ src4392::SRC4392::Intgr{ 0, 0, 1 }, &done };
+
+    // Status on page 0, channel status and user data on page 1
+    src.readCS();
+    src.readRxStatus();
+    src.readU();
+    src.submit(spiq);
+    sim::run(1000000);
+
+    CHECK(done.count == 1);
+    CHECK(spiq.idle());
+    CHECK(chip.frames.size() == 3);
+    if (chip.frames.size() != 3)
+        return;
+    // Page 0 comes first, since the chip is on it
+    CHECK(chip.frames[0].mosi.size() == 2 + 4);
+    CHECK(chip.frames[0].mosi[0] == 0x92);
+    // The page switch
+    CHECK(chip.frames[1].mosi.size() == 3);
+    CHECK(chip.frames[1].mosi[0] == 0x7F);
+    CHECK(chip.frames[1].mosi[2] == 0x01);
+    // Channel status and user data merged into one read, across the gap
+    CHECK(chip.frames[2].mosi.size() == 2 + 0x70);
+    CHECK(chip.frames[2].mosi[0] == 0x80);
+    // One merge, and one page switch instead of four in the order given,
+    // returning to page 0
+    CHECK(src.savedTransfers() == 4);
+
+    // The read data ends up in the staging buffer and then the cache
+    std::array<uint32_t, 2> changed{};
+    auto diff = src.commitCS(changed);
+    CHECK(bool(diff));
+    std::byte page{1};
+    CHECK(*src.getPtr(0x00, page) == std::byte(0xA3));
+    CHECK(*src.getPtr(0x2F, page) == std::byte(0xA3 + 0x2F));
+
+    // Transfers don't overlap. The end of a frame includes the gap.
+    for (size_t i = 1; i < chip.frames.size(); ++i)
+        CHECK(chip.frames[i].start >= chip.frames[i - 1].end);
+
+    auto const &stats = bus.stats();
+    CHECK(stats.transfers == 3);
+    CHECK(stats.overlaps == 0);
+    CHECK(stats.contention == 0);
+    CHECK(stats.bytes == 6 + 3 + 0x72);
+
+    // The chip stays on page 1, so this needs no page switch
+    chip.frames.clear();
+    src.readU();
+    src.submit(spiq);
+    sim::run(2000000);
+    CHECK(done.count == 2);
+    CHECK(chip.frames.size() == 1);
+
+    // Page 0 reads with a gap between them stay apart, so the registers in
+    // between are neither read nor overwritten in the cache
+    page = std::byte{0};
+    *src.getPtr(0x0B, page) = std::byte{0x5A};
+    chip.frames.clear();
+    src.readTxStatus();
+    src.readRxStatus();
+    src.submit(spiq);
+    sim::run(3000000);
+    CHECK(done.count == 3);
+    CHECK(chip.frames.size() == 3);
+    if (chip.frames.size() == 3) {
+        CHECK(chip.frames[1].mosi.size() == 2 + 1);
+        CHECK(chip.frames[1].mosi[0] == 0x8A);
+        CHECK(chip.frames[2].mosi.size() == 2 + 4);
+    }
+    CHECK(*src.getPtr(0x0B, page) == std::byte{0x5A});
+}
+
+void testBroadcast() {
+    sim::Session session;
+    sim::SpiModel bus;
+    std::array<Recorder, 3> chips;
+    for (unsigned i = 0; i < chips.size(); ++i)
+        bus.connect(i, chips[i]);
+    lpc865::SPI::Intgr spiIn{ &bus };
+    lpc865::Spi spi{ spiIn, nullptr, clocking };
+    lpc865::SpiQueue spiq{ spi };
+    Done done;
+    std::array<std::byte, 51> regs{};
+    for (unsigned i = 0; i < regs.size(); ++i)
+        regs[i] = std::byte(i + 1);
+    std::array<lpc865::SpiQueue::Entry, 2> entries;
+
+    src4392::Src4392::broadcast(spiq, entries, regs, 0x7, 0x3, &done);
+    sim::run(1000000);
+
+    CHECK(done.count == 1);
+    for (unsigned i = 0; i < chips.size(); ++i) {
+        auto const &frames = chips[i].frames;
+        CHECK(frames.size() == (i < 2 ? 2u : 1u));
+        if (frames.empty())
+            continue;
+        CHECK(frames[0].mosi[0] == 0x7F);
+        if (frames.size() < 2)
+            continue;
+        CHECK(frames[1].mosi.size() == 2 + regs.size());
+        CHECK(frames[1].mosi[0] == 0x01);
+        CHECK(frames[1].mosi[2 + 50] == 51);
+    }
+    // Several targets selected for writes only
+    CHECK(bus.stats().contention == 0);
+
+    // The queue counts what went over the bus
+    auto stats = spiq.stats();
+    lpc865::SpiQueue::Stats s;
+    std::memcpy(&s, stats.data(), sizeof s);
+    CHECK(s.transfers == 2);
+    CHECK(s.dataBytes == 1 + regs.size());
+    CHECK(s.cmdBytes == 4);
+}
+
+/** The clock of each transfer follows its direction. */
+void testPlan() {
+    sim::Session session;
+    sim::SpiModel bus;
+    Recorder chip;
+    bus.connect(0, chip);
+    lpc865::SPI::Intgr spiIn{ &bus };
+    lpc865::Spi spi{ spiIn, nullptr, clocking };
+    lpc865::SpiQueue spiq{ spi };
+    Done done;
+    src4392::Src4392 src{ src4392::SRC4392::Intgr{ 0, 0, 1 }, &done };
+
+    src.readRegs();
+    src.submit(spiq);
+    sim::run(1000000);
+    src.writeRegs();
+    src.submit(spiq);
+    sim::run(2000000);
+    CHECK(done.count == 2);
+    CHECK(chip.frames.size() == 2);
+    if (chip.frames.size() != 2)
+        return;
+    auto span = [](Recorder::Frame const &f) { return f.end - f.start; };
+    // Same size, but reads run at 15 MHz and writes at 30 MHz
+    uint32_t limit = lpc865::Spi::speedHz(src4392::Src4392::maxSpeed);
+    auto rd = lpc865::Spi::plan(clocking, limit, true);
+    auto wr = lpc865::Spi::plan(clocking, limit, false);
+    CHECK(rd.hz == 15000000);
+    CHECK(wr.hz == 30000000);
+    CHECK(span(chip.frames[0]) == rd.ns(2 + 51));
+    CHECK(span(chip.frames[1]) == wr.ns(2 + 51));
+}
+
+/** A saved configuration has the output ports as the host set them, also
+ * while the SRC is bypassed for compressed data.
+ */
+void testConfig() {
+    src4392::Src4392 src{ src4392::SRC4392::Intgr{ 0, 0, 1 }, nullptr };
+    std::byte page{0};
+    *src.getPtr(0x03, page) = std::byte{0x31};      // port A from the SRC
+    *src.getPtr(0x05, page) = std::byte{0x21};      // port B from the DIR
+    CHECK(src.bypass(true));
+    CHECK(*src.getPtr(0x03, page) == std::byte{0x21});
+
+    std::vector<std::byte> saved;
+    for (auto part : src.config())
+        saved.insert(saved.end(), part.begin(), part.end());
+    CHECK(saved.size() == src4392::Src4392::configSize);
+    CHECK(saved[0x03 - 1] == std::byte{0x31});
+    CHECK(saved[0x05 - 1] == std::byte{0x21});
+    // The cache itself stays bypassed
+    CHECK(*src.getPtr(0x03, page) == std::byte{0x21});
+
+    // Restored, the bypass comes and goes as before
+    src4392::Src4392 restored{ src4392::SRC4392::Intgr{ 1, 0, 1 }, nullptr };
+    CHECK(restored.restore(saved));
+    CHECK(restored.bypass(true));
+    CHECK(restored.bypass(false));
+    CHECK(*restored.getPtr(0x03, page) == std::byte{0x31});
+    CHECK(*restored.getPtr(0x05, page) == std::byte{0x21});
+}
+
+/** diffCopy() finds the same changes as a byte by byte comparison, on
+ * aligned and unaligned buffers, and for any number of changed bytes.
+ */
+void testDiff() {
+    std::mt19937 rng{ 7 };
+    alignas(4) std::array<std::byte, 72> copy;
+    alignas(4) std::array<std::byte, 72> src;
+    for (unsigned round = 0; round < 1000; ++round) {
+        size_t offset = round % 4;
+        size_t size = round % 67;
+        for (auto &b : copy)
+            b = std::byte(rng());
+        src = copy;
+        unsigned changes = round % 5;
+        for (unsigned n = 0; n < changes && size; ++n)
+            src[offset + rng() % size] ^= std::byte(1u << (rng() % 8));
+
+        std::array<uint32_t, 3> expected{};
+        size_t first = 0, last = 0;
+        for (size_t i = 0; i < size; ++i) {
+            if (copy[offset + i] != src[offset + i]) {
+                expected[i / 32] |= 1u << (i % 32);
+                first = last ? first : i;
+                last = i + 1;
+            }
+        }
+        std::array<uint32_t, 3> changed;
+        changed.fill(0xFFFFFFFF);
+        auto d = diffCopy(std::span(copy).subspan(offset, size), std::span(src).subspan(offset, size), changed);
+        CHECK(d.first == first && d.last == last);
+        CHECK(changed == expected);
+        CHECK(std::memcmp(copy.data() + offset, src.data() + offset, size) == 0);
+    }
+}
+
+} // namespace
+
+int main() {
+    testBatch();
+    testBroadcast();
+    testPlan();
+    testConfig();
+    testDiff();
+    return checkResult();
+}
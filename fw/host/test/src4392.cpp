@@ -0,0 +1,381 @@
+/** @file
+ * Test of the SRC4392 driver and the channel against the behavioural model
+ * of the chip, including the protocol violations the model flags.
+ */
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include "check.h"
+
+import handler;
+import aes3;
+import sim;
+import src4392_model;
+import FTM;
+import MRT;
+import PINT;
+import SPI;
+import SRC4392;
+import ftm_drv;
+import mrt_drv;
+import pint_drv;
+import spi_drv;
+import spi_queue;
+import src4392_drv;
+import src4392_init;
+import timer;
+import channel;
+import clkmgr;
+
+namespace {
+
+constexpr lpc865::Spi::Clocking clocking{ 60000000, 30000000, 60, 50, 50, 100 };
+constexpr sim::Time us = 1000;
+constexpr sim::Time ms = 1000000;
+
+struct Done : Handler {
+    Done() : Handler{readySet} {}
+    void act() override { ++count; }
+    unsigned count = 0;
+};
+
+/** One chip on the bus, driven by the SRC4392 driver. */
+struct Bench {
+    sim::SpiModel bus;
+    sim::Src4392Model chip;
+    lpc865::SPI::Intgr spiIn{ &bus };
+    lpc865::Spi spi{ spiIn, nullptr, clocking };
+    lpc865::SpiQueue spiq{ spi };
+    Done done;
+    src4392::Src4392 src{ src4392::SRC4392::Intgr{ 0, 0, 1 }, &done };
+
+    Bench() { bus.connect(0, chip); }
+};
+
+/** Register writes and reads with auto-increment, and page switches. */
+void testProtocol() {
+    sim::Session session;
+    Bench b;
+    b.src.initRegs(src4392::initBase, src4392::initChannelA);
+    b.src.writeRegs();
+    b.src.submit(b.spiq);
+    sim::run(1 * ms);
+    CHECK(b.done.count == 1);
+    CHECK(b.chip.reg(0x01) == 0x3F);
+    CHECK(b.chip.reg(0x03) == 0x39);
+    CHECK(b.chip.reg(0x16) == 0x07);
+    CHECK(b.chip.reg(0x18) == 0x0A);
+    CHECK(b.chip.reg(0x31) == 0x00);
+
+    // Transmit data goes to page 2, and the chip stays there
+    b.src.writeCS();
+    b.src.submit(b.spiq);
+    sim::run(2 * ms);
+    CHECK(b.done.count == 2);
+    CHECK(b.chip.page() == 2);
+
+    // Received data comes from page 1, with the block before the last flip
+    std::array<uint8_t, sim::Src4392Model::bufferSize> rx;
+    for (unsigned i = 0; i < rx.size(); ++i)
+        rx[i] = uint8_t(i ^ 0x5A);
+    b.chip.receive(rx);
+    b.chip.startReceiver(3 * ms, 1 * ms);
+    sim::run(3 * ms + 100 * us);
+    b.src.readCS();
+    b.src.readU();
+    b.src.submit(b.spiq);
+    sim::run(3 * ms + 500 * us);
+    CHECK(b.done.count == 3);
+    b.src.commitCS();
+    b.src.commitU();
+    std::byte page{1};
+    CHECK(*b.src.getPtr(0x05, page) == std::byte(0x05 ^ 0x5A));
+    CHECK(*b.src.getPtr(0x6F, page) == std::byte(0x6F ^ 0x5A));
+
+    CHECK(b.chip.violations().total() == 0);
+    CHECK(b.chip.traffic().transfers == b.bus.stats().transfers);
+    CHECK(b.chip.traffic().bytes == b.bus.stats().bytes);
+}
+
+/** A page 1 read that runs into the next block start straddles a flip. */
+void testStraddle() {
+    sim::Session session;
+    Bench b;
+    b.chip.startReceiver(100 * us, 1 * ms);
+    // The read of 114 bytes at 15 MHz takes about 62 µs.
+    sim::run(1090 * us);
+    b.src.readCS();
+    b.src.readU();
+    b.src.submit(b.spiq);
+    sim::run(1300 * us);
+    CHECK(b.done.count == 1);
+    CHECK(b.chip.violations().rxStraddles == 1);
+
+    // Well within the block it doesn't
+    b.src.readCS();
+    b.src.readU();
+    b.src.submit(b.spiq);
+    sim::run(1600 * us);
+    CHECK(b.done.count == 2);
+    CHECK(b.chip.violations().rxStraddles == 1);
+
+    // The same for a transmit write across a transmitter block start
+    b.chip.startTransmitter(2 * ms, 1 * ms);
+    sim::run(1990 * us);
+    b.src.writeCS();
+    b.src.writeU();
+    b.src.submit(b.spiq);
+    sim::run(2500 * us);
+    CHECK(b.done.count == 3);
+    CHECK(b.chip.violations().txStraddles == 1);
+}
+
+/** Transfers that break the protocol, issued on the bus directly. */
+void testViolations() {
+    sim::Session session;
+    sim::SpiModel bus;
+    sim::Src4392Model chip;
+    bus.connect(0, chip);
+    auto xfer = [&](int ins, uint8_t dummy, bool read, std::span<uint8_t> data) {
+        bus.command(0x01, ins, dummy, read);
+        bus.start(data.data(), data.size(), 10 * us, 100, 500);
+        sim::run(sim::now() + 20 * us);
+    };
+    std::array<uint8_t, 4> data{ 3, 0, 0, 0 };
+
+    xfer(0x7F, 1, false, std::span(data).first(1));
+    CHECK(chip.violations().badPage == 1);
+    data[0] = 1;
+    xfer(0x7F, 1, false, std::span(data).first(1));
+    CHECK(chip.page() == 1);
+    xfer(0x00, 1, false, std::span(data).first(2));
+    CHECK(chip.violations().readOnly == 2);
+    // No dummy byte, so the data is taken for it
+    xfer(0x80, 0, true, std::span(data).first(1));
+    CHECK(chip.violations().truncated == 1);
+    // Past the page register
+    xfer(0xFE, 1, true, std::span(data).first(3));
+    CHECK(chip.violations().overrun == 1);
+    data[0] = 2;
+    xfer(0x7F, 1, false, std::span(data).first(1));
+    xfer(0x30, 1, false, std::span(data).first(1));
+    CHECK(chip.violations().unmapped == 1);
+}
+
+/** A receiver with a persistent error condition, and the channel handling
+ * its interrupts.
+ */
+struct System {
+    sim::SpiModel bus;
+    sim::PintModel pins;
+    sim::FtmModel ftmModel{ 8 * 192000 };
+    sim::Src4392Model chip;
+    lpc865::SPI::Intgr spiIn{ &bus };
+    lpc865::PINT::Intgr pintIn{ &pins };
+    lpc865::FTM::Intgr ftmIn{ &ftmModel, 5 };
+    lpc865::Spi spi{ spiIn, nullptr, clocking };
+    lpc865::SpiQueue spiq{ spi };
+    lpc865::Pint pint{ pintIn };
+    lpc865::Ftm ftm{ ftmIn, { .mod = 0xFFFF, .ch = { {}, { .mode = lpc865::Ftm::compare }, { .mode = lpc865::Ftm::captureNeg } } } };
+    Channel::Integration integration;
+    Channel chan;
+
+    explicit System(std::span<std::byte const> base)
+        : integration{ { 0, 0, 1 }, 0, 2, 0, 1, base, {} }
+        , chan{ integration, spiq, ftm, pint }
+    {
+        bus.connect(0, chip);
+        pins.connect(0, chip.irq);
+        ftmModel.connect(2, chip.irq);
+    }
+};
+
+/** Status read transfers for a receiver that locks, then loses its lock
+ * and stays unlocked, with the given initial register values.
+ */
+uint64_t unlockReads(std::span<std::byte const> base) {
+    sim::Session session;
+    System s{ base };
+    s.chan.initSrc(true);
+    sim::run(1 * ms);
+    CHECK(s.chan.configured());
+    s.chip.startReceiver(2 * ms, 1 * ms);
+    sim::run(10 * ms + 500 * us);
+    CHECK(s.chan.receiving());
+    uint64_t locked = s.chip.traffic().statusReads;
+    s.chip.stopReceiver();
+    s.chip.condition(sim::Src4392Model::srcUnlock, true, sim::now());
+    sim::run(20 * ms);
+    CHECK(!s.chan.receiving());
+    CHECK(s.chip.violations().total() == 0);
+    // Each status read transfer reads registers 0x13 and 0x14
+    return (s.chip.traffic().statusReads - locked) / 2;
+}
+
+/** The shipped interrupt modes report a persistent condition once. In level
+ * mode, it keeps the interrupt line low, and the status reads never stop.
+ */
+void testUnlock() {
+    CHECK(unlockReads(src4392::initBase) == 1);
+
+    std::array<std::byte, std::size(src4392::initBase)> level;
+    std::ranges::copy(src4392::initBase, level.begin());
+    level[0x18 - 1] = std::byte{0x2A};
+    level[0x19 - 1] = std::byte{0xA8};
+    level[0x1A - 1] = std::byte{0x02};
+    CHECK(unlockReads(level) > 100);
+}
+
+/** The microphone status is decoded from the user data of subchannel A, and
+ * only counted as changed when the decoded status changes.
+ */
+void testMicStatus() {
+    sim::Session session;
+    System s{ src4392::initBase };
+    s.chan.initSrc(true);
+    sim::run(1 * ms);
+    auto status = [] {
+        Channel::Status st;
+        std::memcpy(&st, Channel::status().data(), sizeof st);
+        return st;
+    };
+    Channel::Status st0 = status();
+
+    std::array<uint8_t, sim::Src4392Model::bufferSize> page1{};
+    page1[0x00] = 0x01;         // professional format
+    page1[0x02] = 0x10;         // user data in the 192-bit block structure
+    constexpr uint8_t user[] = { 0x25, 0x03, 0x80, 0x05, 0x12, 0x34 };
+    for (unsigned i = 0; i < std::size(user); ++i)
+        page1[0x40 + 2 * i] = user[i];
+    s.chip.receive(page1);
+    s.chip.startReceiver(2 * ms, 1 * ms);
+    sim::run(5 * ms + 500 * us);
+    Channel::Status st = status();
+    CHECK(st.mic.flags == (aes3::mfValid | aes3::mfSynced | aes3::mfCommandError));
+    CHECK(st.mic.dcm[0] == 0x25 && st.mic.dcm[1] == 0x03 && st.mic.dcm[2] == 0x80);
+    CHECK(st.mic.status == 0x05);
+    CHECK(st.mic.response[0] == 0x12 && st.mic.response[1] == 0x34);
+    CHECK(uint8_t(st.micSeq - st0.micSeq) == 1);
+
+    // Other user data doesn't change the microphone status
+    page1[0x50] = 0x77;
+    s.chip.receive(page1);
+    sim::run(7 * ms + 500 * us);
+    Channel::Status st1 = status();
+    CHECK(st1.uSeq != st.uSeq);
+    CHECK(st1.micSeq == st.micSeq);
+
+    // Nor is it decoded without the block structure
+    page1[0x02] = 0x00;
+    s.chip.receive(page1);
+    sim::run(9 * ms + 500 * us);
+    st = status();
+    CHECK(st.mic.flags == 0);
+    CHECK(uint8_t(st.micSeq - st1.micSeq) == 1);
+    CHECK(s.chip.violations().total() == 0);
+}
+
+/** Four chips, brought up by the channel management. */
+struct Board {
+    static constexpr unsigned channels = Channel::maxChannels;
+
+    sim::SpiModel bus;
+    sim::PintModel pins;
+    sim::FtmModel ftmModel{ 8 * 192000 };
+    sim::MrtModel mrtModel{ 60000000 };
+    std::array<sim::Src4392Model, channels> chips;
+    lpc865::SPI::Intgr spiIn{ &bus };
+    lpc865::PINT::Intgr pintIn{ &pins };
+    lpc865::FTM::Intgr ftmIn{ &ftmModel, 5 };
+    lpc865::MRT::Intgr mrtIn{ &mrtModel };
+    lpc865::Spi spi{ spiIn, nullptr, clocking };
+    lpc865::SpiQueue spiq{ spi };
+    lpc865::Pint pint{ pintIn };
+    lpc865::Ftm ftm{ ftmIn, { .mod = 0xFFFF, .ch = { {}, { .mode = lpc865::Ftm::compare },
+        { .mode = lpc865::Ftm::captureNeg }, { .mode = lpc865::Ftm::captureNeg },
+        { .mode = lpc865::Ftm::captureNeg }, { .mode = lpc865::Ftm::captureNeg } } } };
+    lpc865::Mrt mrt{ mrtIn };
+    TimerWheel timers{ mrt };
+    Channel::Integration integration[channels] = {
+        { { 0, 0, 1 }, 0, 2, 0, 1, src4392::initBase, src4392::initChannelA },
+        { { 1, 0, 1 }, 1, 3, 0, 1, src4392::initBase, {} },
+        { { 2, 0, 1 }, 2, 4, 0, 1, src4392::initBase, {} },
+        { { 3, 0, 1 }, 3, 5, 0, 1, src4392::initBase, {} },
+    };
+    Channel chan[channels] = {
+        { integration[0], spiq, ftm, pint },
+        { integration[1], spiq, ftm, pint },
+        { integration[2], spiq, ftm, pint },
+        { integration[3], spiq, ftm, pint },
+    };
+    ChannelManagement mgmt{ chan, spiq, timers };
+
+    Board() {
+        for (unsigned n = 0; n < channels; ++n) {
+            bus.connect(n, chips[n]);
+            pins.connect(n, chips[n].irq);
+            ftmModel.connect(2 + n, chips[n].irq);
+        }
+        timers.start(0, 60000);
+    }
+
+    /** Write a page 0 register over I2C, as the host does. */
+    void hostWrite(unsigned n, uint8_t reg, uint8_t value) {
+        CHECK(chan[n].select(uint8_t((0x70 + n) << 1)));
+        chan[n].putRxByte(reg);
+        chan[n].putRxByte(value);
+        chan[n].deselect();
+        chan[n].post();
+    }
+};
+
+/** A repeated bring-up keeps the registers the host has written, on the
+ * chip as in the cache, while the first one writes the shared table.
+ */
+void testRepeat() {
+    sim::Session session;
+    Board b;
+    b.mgmt.post();
+    for (unsigned n = 0; n < Board::channels; ++n)
+        b.chips[n].startReceiver(2 * ms + n * 20 * us, 1 * ms);
+    sim::run(10 * ms);
+    for (unsigned n = 0; n < Board::channels; ++n) {
+        CHECK(b.chan[n].configured());
+        CHECK(b.chan[n].receiving());
+    }
+    uint8_t base = uint8_t(src4392::initBase[0x03 - 1]);
+    CHECK(b.chips[2].reg(0x03) == base);
+
+    uint8_t value = base ^ 0x01;
+    b.hostWrite(2, 0x03, value);
+    sim::run(12 * ms);
+    CHECK(b.chips[2].reg(0x03) == value);
+
+    // The bring-up has ended with the first blocks, so it can be repeated
+    b.mgmt.post();
+    sim::run(20 * ms);
+    for (unsigned n = 0; n < Board::channels; ++n) {
+        CHECK(b.chan[n].configured());
+        CHECK(b.chan[n].receiving());
+        CHECK(b.chips[n].violations().total() == 0);
+    }
+    CHECK(b.chips[2].reg(0x03) == value);
+    CHECK(b.chips[3].reg(0x03) == base);
+    auto *reg = b.chan[2].config()[1].data();
+    CHECK(uint8_t(*reg) == value);
+}
+
+} // namespace
+
+int main() {
+    testProtocol();
+    testStraddle();
+    testViolations();
+    testUnlock();
+    testMicStatus();
+    testRepeat();
+    return checkResult();
+}
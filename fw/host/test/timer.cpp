@@ -0,0 +1,181 @@
+/** @file
+ * Test of the timer wheel, ticked by the MRT model.
+ *
+ * Several hundred timers are armed with random delays of up to 2^16 ticks,
+ * from a generator with a fixed seed, so the run is the same every time. The
+ * delays cover the slots of both levels and the parking beyond them. Each
+ * timer records the tick it fires at, which must be exactly the tick it was
+ * armed for, and the timers must fire in the order of their expiries. Some
+ * timers re-arm themselves when they fire, so that they are inserted at
+ * arbitrary times, and some are cancelled on the way, which must never fire.
+ */
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "check.h"
+
+import handler;
+import sim;
+import MRT;
+import mrt_drv;
+import timer;
+
+namespace {
+
+constexpr uint32_t mrtHz = 60000000;
+constexpr uint32_t tickCycles = mrtHz / 1000;   // 1 ms per tick, as on the target
+constexpr sim::Time tickNs = 1000000;
+constexpr uint32_t maxDelay = 1u << 16;
+constexpr unsigned count = 500;
+
+TimerWheel *wheel = nullptr;
+std::mt19937 rng{ 42 };
+
+uint32_t randomDelay() {
+    return std::uniform_int_distribution<uint32_t>{ 1, maxDelay }(rng);
+}
+
+/** A timer with a handler that records its expiries. */
+struct Probe : Handler {
+    Probe() : timer{ *this } {}
+
+    void arm(uint32_t delay) {
+        due = wheel->now() + (delay ? delay : 1);   // a delay of 0 is taken as 1
+        wheel->arm(timer, delay);
+    }
+
+    void act() override;
+
+    Timer timer;
+    uint32_t due = 0;           //!< Tick the timer is armed for
+    unsigned fired = 0;
+    unsigned late = 0;          //!< Expiries at another tick than armed for
+    unsigned rearms = 0;        //!< Times left to re-arm on expiry
+    unsigned expected = 1;      //!< Expiries if not cancelled
+    bool cancelled = false;
+    unsigned firedAtCancel = 0;
+};
+
+/** An expiry, in the order they happened. */
+struct Expiry {
+    uint32_t tick;
+    uint32_t due;
+};
+
+std::vector<Expiry> expiries;
+
+void Probe::act() {
+    ++fired;
+    if (wheel->now() != due)
+        ++late;
+    expiries.push_back({ wheel->now(), due });
+    if (rearms) {
+        --rearms;
+        arm(randomDelay());
+    }
+}
+
+struct Wheel {
+    sim::Session session;
+    sim::MrtModel model{ mrtHz };
+    lpc865::MRT::Intgr in{ &model };
+    lpc865::Mrt mrt{ in };
+    TimerWheel timers{ mrt };
+
+    Wheel() {
+        wheel = &timers;
+        timers.start(0, tickCycles);
+    }
+    ~Wheel() { wheel = nullptr; }
+
+    void runTo(uint32_t tick) { sim::run(sim::Time(tick) * tickNs + tickNs / 2); }
+};
+
+/** Random one-shot timers, some re-armed, some cancelled. */
+void testRandom() {
+    Wheel w;
+    expiries.clear();
+    static std::array<Probe, count> probes;
+
+    // The boundaries of the levels first, then random delays
+    constexpr uint32_t edges[] = { 0, 1, 2, 31, 32, 33, 1023, 1024, 1025, 2047, 2048, maxDelay - 1, maxDelay };
+    for (unsigned n = 0; n < count; ++n) {
+        auto &p = probes[n];
+        p.rearms = n % 4 == 0 ? 3 : 0;
+        p.expected = 1 + p.rearms;
+        p.arm(n < std::size(edges) ? edges[n] : randomDelay());
+    }
+
+    // Arm some timers again at a time that isn't aligned to a slot
+    w.runTo(777);
+    for (unsigned n = 1; n < count; n += 10) {
+        auto &p = probes[n];
+        if (p.fired == 0)
+            p.arm(randomDelay());
+    }
+
+    // Cancel some while they are parked, in level 1, or in level 0
+    w.runTo(5000);
+    unsigned cancelled = 0;
+    for (unsigned n = 3; n < count; n += 7) {
+        auto &p = probes[n];
+        if (p.timer.armed()) {
+            w.timers.cancel(p.timer);
+            p.cancelled = true;
+            p.firedAtCancel = p.fired;
+            ++cancelled;
+        }
+        CHECK(!p.timer.armed());
+        w.timers.cancel(p.timer);       // nothing happens if it isn't armed
+    }
+    CHECK(cancelled > 50);
+
+    w.runTo(5 * maxDelay);
+
+    for (auto &p : probes) {
+        CHECK(!p.timer.armed());
+        CHECK(p.late == 0);
+        CHECK(p.fired == (p.cancelled ? p.firedAtCancel : p.expected));
+    }
+    // As each timer fires at its due tick, they fire in the order of expiry
+    for (size_t i = 1; i < expiries.size(); ++i)
+        CHECK(expiries[i - 1].due <= expiries[i].due);
+    CHECK(expiries.size() > count);
+}
+
+/** A periodic timer keeps its period over the cascades, relative to its
+ * first expiry.
+ */
+void testPeriodic() {
+    Wheel w;
+    struct Periodic : Handler {
+        explicit Periodic(uint32_t period) : timer{ *this, period } {}
+        void act() override { ticks.push_back(wheel->now()); }
+        Timer timer;
+        std::vector<uint32_t> ticks;
+    };
+    static Periodic p32{ 32 }, p1500{ 1500 };
+    w.timers.arm(p32.timer, 5);
+    w.timers.arm(p1500.timer, 1500);
+    w.runTo(3 * 1024 + 10);
+    w.timers.cancel(p32.timer);
+    w.timers.cancel(p1500.timer);
+    w.runTo(2 * maxDelay);
+
+    CHECK(p32.ticks.size() == (3 * 1024 + 10 - 5) / 32 + 1);
+    for (size_t i = 0; i < p32.ticks.size(); ++i)
+        CHECK(p32.ticks[i] == 5 + 32 * i);
+    CHECK(p1500.ticks.size() == 2);
+    for (size_t i = 0; i < p1500.ticks.size(); ++i)
+        CHECK(p1500.ticks[i] == 1500 * (i + 1));
+}
+
+} // namespace
+
+int main() {
+    testRandom();
+    testPeriodic();
+    return checkResult();
+}
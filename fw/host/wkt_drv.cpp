@@ -0,0 +1,32 @@
+/** @file
+ * driver for the LPC8 WKT, on the WKT model of the host simulation.
+ * @addtogroup Host
+ * @{
+ */
+module;
+#include <cstdint>
+module wkt_drv;
+import WKT;
+import sim;
+
+using namespace lpc865::WKT;
+
+void lpc865::Wkt::isr() {
+    if (hdl_)
+        hdl_->post();
+}
+
+void lpc865::Wkt::start(uint32_t count, Handler &hdl) {
+    hdl_ = &hdl;
+    in_.model->start(count);
+}
+
+/** The clock source is given to the model instead. */
+lpc865::Wkt::Wkt(Intgr const &in, Parameters const &)
+    : in_{in}
+    , hdl_{nullptr}
+{
+    in_.model->attach(*this);
+}
+
+/** @}*/
@@ -0,0 +1,185 @@
+/** @file
+ * support for the LPC8 ADC block.
+ * @addtogroup LPC865_adc
+ * @ingroup LPC865
+ * @{
+ */
+module;
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+module adc_drv;
+import hwreg;
+import nvic_drv;
+import ADC;
+
+#define FIELDMASK(t, f) []() constexpr { t r{}; r.f -= 1; return std::bit_cast<hwreg::HwReg<t>::Native>(r); }()
+#define FIELDVAL(t, f, v) []() constexpr { t r{}; r.f = v; return std::bit_cast<hwreg::HwReg<t>::Native>(r); }()
+
+using namespace lpc865::ADC;
+
+// Fields of the sequence global data register, as stored in the ring
+static constexpr uint32_t gdatValid = 1u << 31;
+static constexpr unsigned gdatChnShift = 26;
+static constexpr unsigned gdatResultShift = 4;
+
+std::span<std::byte> lpc865::Adc::readout() {
+    return std::as_writable_bytes(std::span(&out_, 1));
+}
+
+uint16_t lpc865::Adc::toRaw(uint16_t mv) const {
+    return uint16_t(std::min<uint32_t>(uint32_t(mv) * 4096 / par_.fullScale, 4095));
+}
+
+/** Decimate one half of the ring, and run the filters. */
+void lpc865::Adc::process(uint32_t const *data) {
+    uint32_t sum[maxInputs] = {};
+    uint8_t n[maxInputs] = {};
+    for (unsigned i = 0; i < blockFrames * count_; ++i) {
+        uint32_t w = data[i];
+        // The input number comes with the result, so a lost DMA trigger can't
+        // shift the results to a different input.
+        unsigned idx = index_[(w >> gdatChnShift) & 0xF];
+        if ((w & gdatValid) && idx < count_) {
+            sum[idx] += (w >> gdatResultShift) & 0xFFF;
+            ++n[idx];
+        }
+    }
+    for (unsigned i = 0; i < count_; ++i) {
+        if (n[i] == 0)
+            continue;
+        int32_t x = int32_t((sum[i] << 12) / n[i]);
+        if (primed_)
+            filt_[i] += (x - filt_[i]) >> par_.shift;
+        else
+            filt_[i] = x;
+        out_.millivolts[i] = uint16_t((uint32_t(filt_[i] >> 8) * par_.fullScale) >> 16);
+    }
+    primed_ = true;
+}
+
+/** Evaluate the filtered values against the window. */
+void lpc865::Adc::update() {
+    uint8_t set = 0;
+    uint8_t clear = 0;
+    for (unsigned i = 0; i < count_; ++i) {
+        auto mv = out_.millivolts[i];
+        if (mv < par_.low || mv > par_.high)
+            set |= 1u << i;
+        else if (mv >= par_.low + par_.hyst && mv + par_.hyst <= par_.high)
+            clear |= 1u << i;
+    }
+    setFaults(set, clear);
+}
+
+/** Change the fault state, and the compare interrupts along with it.
+ * This is called from both the handler and the interrupt service routine.
+ */
+void lpc865::Adc::setFaults(uint8_t set, uint8_t clear) {
+    static constexpr auto cmpMask = FIELDMASK(INTEN, ADCMPINTEN0);
+    static constexpr auto cmpOutside = FIELDVAL(INTEN, ADCMPINTEN0, 1);
+    static constexpr auto thcmp = FIELDVAL(FLAGS, THCMP0, 1);
+    auto &hw = *in_.registers;
+    arm::disable_irq();
+    uint8_t old = out_.faults;
+    uint8_t now = (old | set) & ~clear;
+    out_.faults = now;
+    uint32_t inten = hw.INTEN.val();
+    uint32_t stale = 0;
+    for (unsigned i = 0; i < count_; ++i) {
+        unsigned shift = 2 * input_[i];
+        inten &= ~(cmpMask << shift);
+        if (!(now & (1u << i))) {
+            inten |= cmpOutside << shift;
+            stale |= thcmp << input_[i];
+        }
+    }
+    hw.FLAGS.set(stale);    // forget excursions from before the interrupt was enabled
+    hw.INTEN.set(inten);
+    arm::enable_irq();
+    if (now != old && par_.notify)
+        par_.notify->post();
+}
+
+/** Threshold compare interrupt.
+ * Only inputs without a fault have the compare interrupt enabled.
+ */
+void lpc865::Adc::isr() {
+    static constexpr auto thcmp = FIELDVAL(FLAGS, THCMP0, 1);
+    auto &hw = *in_.registers;
+    uint32_t flags = hw.FLAGS.val();
+    uint8_t set = 0;
+    uint32_t handled = 0;
+    for (unsigned i = 0; i < count_; ++i) {
+        if (flags & (thcmp << input_[i])) {
+            set |= 1u << i;
+            handled |= thcmp << input_[i];
+        }
+    }
+    hw.FLAGS.set(handled);
+    if (set)
+        setFaults(set, 0);
+}
+
+void lpc865::Adc::act() {
+    uint8_t flags = dma_.takeFlags(par_.dmachan);
+    if (flags == 0)
+        return;
+    if (flags == 3)
+        ++out_.late;    // the order is unknown, and the first half may be overwritten already
+    if (flags & 1)
+        process(ring_);
+    if (flags & 2)
+        process(ring_ + blockFrames * count_);
+    ++out_.blocks;
+    update();
+}
+
+lpc865::Adc::Adc(Intgr const &in, Parameters const &par, Dma &dma)
+    : Handler{readySet}
+    , in_{in}
+    , par_{par}
+    , dma_{dma}
+    , link_{}
+    , ring_{}
+    , filt_{}
+    , index_{}
+    , input_{}
+    , count_{0}
+    , primed_{false}
+    , out_{}
+{
+    std::ranges::fill(index_, 0xFF);
+    for (unsigned n = 0; n < std::size(index_) && count_ < maxInputs; ++n) {
+        if (par.inputs & (1u << n)) {
+            index_[n] = count_;
+            input_[count_++] = n;
+        }
+    }
+
+    auto &hw = *in_.registers;
+    hw.CTRL = CTRL{ .CLKDIV = par.caldiv, .CALMODE = 1 };
+    while (hw.CTRL.get().CALMODE)
+        ;   // self calibration takes about 300 µs
+    hw.CTRL = CTRL{ .CLKDIV = par.clkdiv };
+    hw.THR0_LOW = THR0_LOW{ .THRLOW = toRaw(par.low) };
+    hw.THR0_HIGH = THR0_HIGH{ .THRHIGH = toRaw(par.high) };
+    hw.CHAN_THRSEL.set(0);      // all inputs use threshold set 0
+
+    // The sequence A interrupt flag is set at the end of each conversion, and
+    // only serves as the DMA trigger. Reading the global data register clears it.
+    Dma::Per per{ .chan = par.dmachan, .width = 2, .dest = 0, .hwtrig = 1, .trigpol = 1, .trigburst = 1, .noreq = 1 };
+    Dma::Mem mem{ .chan = par.dmachan, .inc = 1, .setintA = 1, .setintB = 1 };
+    if (count_ == 0
+        || !dma_.setup(per, reinterpret_cast<uintptr_t>(&hw.SEQ_GDAT[0]), this)
+        || !dma_.startRing(mem, ring_, 2 * blockFrames * count_, link_))
+        return;
+    hw.INTEN = INTEN{ .SEQA_INTEN = 1 };
+    setFaults(0, 0);            // enables the compare interrupts
+    bind(in_.exTHCMP);
+    hw.SEQ_CTRL[0] = SEQ_CTRL{ .CHANNELS = par.inputs, .TRIGGER = par.trigger, .TRIGPOL = 1, .SEQ_ENA = 1 };
+}
+
+/** @}*/
@@ -0,0 +1,100 @@
+/** @file
+ * ADC driver.
+ *
+ * @addtogroup LPC865_adc
+ * @ingroup LPC865
+ * @{
+ */
+
+module;
+#include <cstddef>
+#include <cstdint>
+#include <span>
+export module adc_drv;
+import nvic_drv;
+import handler;
+import dma_drv;
+import ADC;
+
+export namespace lpc865 {
+
+/** ADC driver.
+ *
+ * This monitors a few slowly varying analog inputs without any CPU work per
+ * sample. A hardware trigger, typically a timer, starts conversion sequence A
+ * over all inputs. Each conversion result is moved by DMA into a ring buffer,
+ * which is split into two halves. When a half is full, the DMA interrupt posts
+ * the driver as a handler. It decimates the half by averaging each input, and
+ * runs the averages through a first order IIR low-pass filter in fixed point.
+ * The filtered values are published in a readout block, which can be exposed
+ * to the host as a whole.
+ *
+ * All inputs share a window of acceptable values. The threshold compare of
+ * the ADC checks every conversion against it, so that an excursion raises an
+ * interrupt right away, without waiting for the filter. The input is then
+ * marked as faulty, and its compare interrupt stays disabled until the
+ * filtered value has returned into the window by the hysteresis margin.
+ */
+class Adc : public arm::Interrupt, public Handler {
+public:
+    static constexpr unsigned maxInputs = 4;    //!< Number of inputs supported
+    static constexpr unsigned blockFrames = 8;  //!< Sequences per half of the ring, i.e. the decimation factor
+
+    /** Operating parameters. */
+    struct Parameters {
+        uint16_t inputs;        //!< Bitmap of the ADC inputs to convert, at most maxInputs bits set
+        uint8_t trigger;        //!< Hardware trigger input for sequence A
+        uint8_t clkdiv;         //!< ADC clock divider for normal operation
+        uint8_t caldiv;         //!< ADC clock divider for calibration, which needs 500 kHz
+        uint8_t dmachan;        //!< DMA channel, triggered by the sequence A interrupt
+        uint8_t shift;          //!< IIR filter coefficient, as a power of 2
+        uint16_t fullScale;     //!< Input voltage at ADC full scale in mV
+        uint16_t low;           //!< Lower limit of the window in mV
+        uint16_t high;          //!< Upper limit of the window in mV
+        uint16_t hyst;          //!< Hysteresis for leaving the fault state in mV
+        Handler *notify;        //!< Handler to post when the fault state changes, may be null
+    };
+
+    /** Measurement results, updated at the end of each half of the ring. */
+    struct Readout {
+        uint16_t millivolts[maxInputs]; //!< Filtered voltages, in ascending order of the input number
+        uint16_t blocks;        //!< Number of updates so far
+        uint8_t faults;         //!< Bitmap of the inputs outside the window, in the order of millivolts
+        uint8_t late;           //!< Number of times both halves were found full
+    };
+
+    /** Get the readout block, for exposing it to the host. */
+    std::span<std::byte> readout();
+
+    /** Get the current faults.
+     * @return Bitmap of the inputs that are outside the window
+     */
+    uint8_t faults() const { return out_.faults; }
+
+    Adc(ADC::Intgr const &in, Parameters const &par, Dma &dma);
+    ~Adc() =default;
+
+private:
+    void isr() override;
+    void act() override;
+    void process(uint32_t const *frames);
+    void update();
+    void setFaults(uint8_t set, uint8_t clear);
+    uint16_t toRaw(uint16_t mv) const;
+
+    ADC::Intgr const &in_;      //!< Integration values
+    Parameters const &par_;
+    Dma &dma_;
+    alignas(16) Dma::Descriptor link_;          //!< Descriptor for the second half of the ring
+    uint32_t ring_[2 * blockFrames * maxInputs];//!< Ring of sequence A global data register values
+    int32_t filt_[maxInputs];   //!< Filter states, full scale is 1 << 24
+    uint8_t index_[16];         //!< Index of each ADC input in the readout, or 0xFF
+    uint8_t input_[maxInputs];  //!< ADC input number of each index
+    uint8_t count_;             //!< Number of inputs
+    bool primed_;               //!< Filter states have been initialized
+    Readout out_;
+};
+
+} // namespace
+
+//!@}
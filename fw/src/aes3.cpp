@@ -0,0 +1,78 @@
+/** @file
+ * AES3 channel status and AES42 user data support.
+ * @addtogroup AES3
+ * @ingroup AES42HAT
+ * @{
+ */
+module;
+#include <array>
+#include <cstddef>
+#include <cstdint>
+module aes3;
+
+namespace {
+
+// Reference vectors. This is the standard check value of CRC-8/AES, also
+// known as CRC-8/EBU.
+constexpr std::array<std::byte, 9> checkString = {
+    std::byte{'1'}, std::byte{'2'}, std::byte{'3'}, std::byte{'4'}, std::byte{'5'},
+    std::byte{'6'}, std::byte{'7'}, std::byte{'8'}, std::byte{'9'}
+};
+static_assert(aes3::crc8(checkString.data(), checkString.size()) == 0x97);
+
+// A sealed block passes the check, also with interleaved subchannels, and
+// fails after a change.
+constexpr bool selfTest() {
+    std::array<std::byte, 2 * aes3::csBlockSize> cs{};
+    for (size_t i = 0; i < cs.size(); ++i)
+        cs[i] = std::byte(i * 37 + 1);
+    aes3::seal(cs.data(), 2);
+    aes3::seal(cs.data() + 1, 2);
+    if (!aes3::check(cs.data(), 2) || !aes3::check(cs.data() + 1, 2))
+        return false;
+    cs[10] ^= std::byte{0x04};
+    return !aes3::check(cs.data(), 2) && aes3::check(cs.data() + 1, 2);
+}
+static_assert(selfTest());
+
+} // namespace
+
+aes3::Summary aes3::summarize(std::byte const *block, size_t stride) {
+    // Bit 0 is the first bit of a byte, hence the codes in the standard, which
+    // are written in transmission order, appear bit reversed here.
+    static constexpr uint16_t baseRate[4] = { 0, 4410, 4800, 3200 };
+    static constexpr uint16_t extRate[16] = {
+        0, 2400, 9600, 19200, 0, 0, 0, 0, 0, 2205, 8820, 17640, 0, 0, 0, 0
+    };
+    auto byte = [block, stride](size_t n) { return uint8_t(block[n * stride]); };
+    uint8_t b0 = byte(0);
+    Summary s{};
+    if (!(b0 & 0x01))
+        return s;       // consumer format
+    s.flags = sfProfessional | ((b0 & 0x02) ? sfNonAudio : 0) | ((b0 & 0x20) ? sfUnlocked : 0);
+    s.emphasis = (b0 >> 2) & 0x07;
+    s.channelMode = byte(1) & 0x0F;
+    s.wordLength = byte(2) & 0x3F;
+    uint16_t ext = extRate[(byte(4) >> 3) & 0x0F];
+    s.rate = ext ? ext : baseRate[b0 >> 6];
+    return s;
+}
+
+aes3::MicStatus aes3::summarizeMic(std::byte const *cs, std::byte const *u, size_t stride) {
+    // User bits management code 1000 in transmission order, i.e. bit 4 set
+    static constexpr uint8_t blockStructure = 0x01;
+    auto byte = [u, stride](size_t n) { return uint8_t(u[n * stride]); };
+    MicStatus m{};
+    if (!isProfessional(cs) || (uint8_t(cs[stride]) >> 4) != blockStructure)
+        return m;
+    m.dcm[0] = byte(0);
+    m.dcm[1] = byte(1);
+    m.dcm[2] = byte(2);
+    m.status = byte(3);
+    m.response[0] = byte(4);
+    m.response[1] = byte(5);
+    m.flags = mfValid | uint8_t((m.status & 0x0F) << 1);   // status bits 0..3 are flags bits 1..4
+    return m;
+}
+
+/** @}*/
@@ -0,0 +1,128 @@
+/** @file
+ * AES3 channel status and AES42 user data support.
+ *
+ * @addtogroup AES3
+ * @ingroup AES42HAT
+ * @{
+ */
+
+module;
+#include <array>
+#include <cstddef>
+#include <cstdint>
+export module aes3;
+
+export namespace aes3 {
+
+inline constexpr size_t csBlockSize = 24;   //!< Bytes in a channel status block
+inline constexpr size_t crccByte = 23;      //!< Offset of the CRCC in the block
+
+/** CRC lookup table for CRC-8/AES.
+ * The polynomial is x^8 + x^4 + x^3 + x^2 + 1, processed LSB first, as the
+ * channel status bits are transmitted LSB first.
+ */
+inline constexpr std::array<uint8_t, 256> crcTable = []() constexpr {
+    std::array<uint8_t, 256> t{};
+    for (unsigned i = 0; i < 256; ++i) {
+        uint8_t c = i;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? (c >> 1) ^ 0xB8 : c >> 1;
+        t[i] = c;
+    }
+    return t;
+}();
+
+/** Calculate the CRC-8/AES of a sequence of bytes.
+ * @param data Pointer to the first byte
+ * @param size Number of bytes
+ * @param stride Distance between consecutive bytes, for interleaved blocks
+ * @param crc Initial value, for continuing a calculation
+ * @return The CRC
+ */
+constexpr uint8_t crc8(std::byte const *data, size_t size, size_t stride = 1, uint8_t crc = 0xFF) {
+    for (; size; --size, data += stride)
+        crc = crcTable[crc ^ uint8_t(*data)];
+    return crc;
+}
+
+/** Check whether a channel status block is in professional format.
+ * Only the professional format has a CRCC.
+ * @param block Byte 0 of the block
+ */
+constexpr bool isProfessional(std::byte const *block) {
+    return (uint8_t(*block) & 0x01) != 0;
+}
+
+/** Insert the CRCC into a channel status block.
+ * @param block Pointer to byte 0
+ * @param stride Distance between consecutive bytes of the block
+ */
+constexpr void seal(std::byte *block, size_t stride = 1) {
+    block[crccByte * stride] = std::byte(crc8(block, crccByte, stride));
+}
+
+/** The commonly needed fields of a channel status block. */
+struct Summary {
+    uint16_t rate;          //!< Sampling rate in units of 10 Hz, 0 if not indicated
+    uint8_t flags;          //!< See enum SummaryFlags
+    uint8_t emphasis;       //!< Emphasis code, byte 0 bits 2..4
+    uint8_t wordLength;     //!< Auxiliary use and word length codes, byte 2 bits 0..5
+    uint8_t channelMode;    //!< Channel mode code, byte 1 bits 0..3
+};
+
+enum SummaryFlags : uint8_t {
+    sfProfessional  = 0x01, //!< Professional format. The other fields are only decoded in this format.
+    sfNonAudio      = 0x02, //!< Not linear PCM audio
+    sfUnlocked      = 0x04, //!< Source sampling frequency not locked
+};
+
+/** Decode the commonly needed fields of a channel status block.
+ * @param block Pointer to byte 0
+ * @param stride Distance between consecutive bytes of the block
+ */
+Summary summarize(std::byte const *block, size_t stride = 1);
+
+/** Status of an AES42 microphone, from the user data of subframe 1.
+ * AES42 microphones send their status in 192-bit user data blocks that start
+ * with the channel status block. The first three bytes mirror the settings
+ * of the last direct command (DCM) the microphone has taken, byte 3 holds the
+ * status bits, and bytes 4 and 5 the response to the last extended remote
+ * control command.
+ */
+struct MicStatus {
+    uint8_t flags;          //!< See enum MicFlags
+    uint8_t dcm[3];         //!< Direct command settings, as mirrored by the microphone
+    uint8_t status;         //!< Status byte as sent, user data byte 3
+    uint8_t response[2];    //!< Response to the last extended command, user data bytes 4 and 5
+    uint8_t reserved;
+};
+
+enum MicFlags : uint8_t {
+    mfValid         = 0x01, //!< User data in the 192-bit block structure. The other fields are only decoded then.
+    mfSynced        = 0x02, //!< Microphone synchronized in mode 2 or 3, status bit 0
+    mfSyncError     = 0x04, //!< Synchronization lost or out of range, status bit 1
+    mfCommandError  = 0x08, //!< Last remote control command not accepted, status bit 2
+    mfMuted         = 0x10, //!< Signal muted by the microphone, status bit 3
+};
+
+/** Decode the AES42 microphone status.
+ * @param cs Byte 0 of the channel status block of the same subframe, whose
+ *        user bits management code (byte 1 bits 4..7) tells whether the user
+ *        data is in the 192-bit block structure
+ * @param u Byte 0 of the user data block
+ * @param stride Distance between consecutive bytes of the blocks
+ */
+MicStatus summarizeMic(std::byte const *cs, std::byte const *u, size_t stride = 1);
+
+/** Check the CRCC of a channel status block.
+ * @param block Pointer to byte 0
+ * @param stride Distance between consecutive bytes of the block
+ * @return true if the CRCC matches
+ */
+constexpr bool check(std::byte const *block, size_t stride = 1) {
+    return crc8(block, csBlockSize, stride) == 0;   // the CRC over data and CRCC leaves no residue
+}
+
+} // namespace
+
+//!@}
@@ -0,0 +1,257 @@
+/** @file
+ * Microbenchmarks of the building blocks on the per-block path.
+ * @addtogroup AES42HAT_bench
+ * @ingroup AES42HAT
+ * @{
+ */
+module;
+#include <algorithm>
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include "coroutine.hpp"
+module bench;
+import nvic_drv;
+import queuering;
+import stackring;
+import src4392_drv;
+import SRC4392;
+import task;
+import utility;
+
+using namespace bench;
+
+namespace {
+
+constexpr unsigned iterations = 64;
+constexpr unsigned batch = 16;      //!< Operations per iteration for the cheap items
+
+/** Keeps the compiler from optimizing across the measured operations. */
+inline void clobber() {
+    asm volatile ("" ::: "memory");
+}
+
+/** Makes the state of an object observable after an operation. The memory
+ * clobber alone doesn't cover a local object whose address never escapes,
+ * which the compiler may keep in registers, or drop altogether.
+ */
+template<typename T> inline void clobber(T &obj) {
+    asm volatile ("" : : "r"(&obj) : "memory");
+}
+
+struct Node {
+    friend QueueRing<Node>::pointer &next(QueueRing<Node>::const_reference n) {
+        return const_cast<QueueRing<Node>::pointer&>(n.next);
+    }
+    Node *next = nullptr;
+};
+
+struct Coro {
+    __attribute__((noinline)) void step() {
+        CORO_REENTER(coro_) {
+            for (;;) {
+                CORO_YIELD ++count_;
+            }
+        }
+    }
+    Coroutine<int8_t> coro_;
+    unsigned count_ = 0;
+};
+
+/** Awaitable that just suspends, and leaves the handle for the caller to resume. */
+struct Suspend {
+    std::coroutine_handle<> &slot;
+    bool await_ready() noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) noexcept { slot = h; }
+    void await_resume() noexcept {}
+};
+
+task::Task taskLoop(std::coroutine_handle<> &slot, unsigned &count) {
+    for (;;) {
+        co_await Suspend{slot};
+        ++count;
+    }
+}
+
+task::Task taskEmpty(unsigned &count) {
+    ++count;
+    co_return;
+}
+
+/** The page 1 read sequence of Channel::resume(), with the work of the
+ * driver in calls that aren't inlined, as the driver lives in another module:
+ * the request flag is taken, the reads are queued, the coroutine waits for
+ * the transfer, and the data is then evaluated. It is written once as a
+ * stackless coroutine and once as a task, to compare code size and resume cost
+ * for the same sequence.
+ */
+struct Sequence {
+    __attribute__((noinline)) void queue() { ++queued; clobber(); }
+    __attribute__((noinline)) void finish() { ++finished; clobber(); }
+
+    bool volatile pending = false;
+    unsigned queued = 0;
+    unsigned finished = 0;
+};
+
+struct SequenceCoro : Sequence {
+    __attribute__((noinline)) void resume() {
+        CORO_REENTER(coro_) {
+            if (pending) {
+                pending = false;
+                CORO_YIELD queue();
+                finish();
+            }
+        }
+        if (coro_.is_complete())
+            coro_ = {};
+    }
+    Coroutine<int8_t> coro_;
+};
+
+__attribute__((noinline)) task::Task sequenceTask(Sequence &s, std::coroutine_handle<> &slot) {
+    if (s.pending) {
+        s.pending = false;
+        s.queue();
+        co_await Suspend{slot};
+        s.finish();
+    }
+}
+
+Results results;
+
+/** Byte by byte diff, as the register cache used to do it. */
+__attribute__((noinline)) uint64_t diffBytewise(std::span<std::byte> copy, std::span<std::byte const> src) {
+    uint64_t res{0};
+    for (size_t i = 0; i < src.size(); ++i) {
+        res |= uint64_t(src[i] != copy[i]) << i;
+        copy[i] = src[i];
+    }
+    return res;
+}
+
+/** Measure the cycles of a number of iterations of an operation. */
+template<typename Op> uint32_t measure(Op op) {
+    arm::disable_irq();
+    uint32_t start = arm::cycleCount();
+    for (unsigned i = 0; i < iterations; ++i) {
+        op(i);
+        clobber();
+    }
+    uint32_t end = arm::cycleCount();
+    arm::enable_irq();
+    return arm::cycleDiff(start, end);
+}
+
+} // namespace
+
+std::span<std::byte> bench::run() {
+    arm::startCycleCounter();
+    // The least of a few, as an interrupted measurement of the loop would
+    // hide the cost of every item, where interrupts can't be disabled
+    uint32_t loop = measure([](unsigned) {});
+    for (unsigned k = 0; k < 3; ++k)
+        loop = std::min(loop, measure([](unsigned) {}));
+    results.loop = uint16_t(loop / iterations);
+    auto store = [loop](Item item, uint32_t cycles, unsigned ops = 1) {
+        results.cycles[item] = uint16_t(((cycles > loop ? cycles - loop : 0) * 16) / (iterations * ops));
+    };
+
+    // The cheap operations run a batch per iteration, each followed by a
+    // clobber of the container, so that they stand out from the loop
+    std::array<Node, batch> nodes;
+    QueueRing<Node> queue;
+    store(queuePushPop, measure([&](unsigned) {
+        for (auto &n : nodes) {
+            queue.push_back(n);
+            clobber(queue);
+        }
+        for (unsigned k = 0; k < batch; ++k) {
+            queue.pop_front();
+            clobber(queue);
+        }
+    }), batch);
+    for (auto &n : nodes)
+        queue.push_back(n);
+    store(queueRotate, measure([&](unsigned) {
+        for (unsigned k = 0; k < batch; ++k) {
+            queue.rotate();
+            clobber(queue);
+        }
+    }), batch);
+    queue.clear();
+
+    StackRing<Node> stack;
+    store(stackPushPop, measure([&](unsigned) {
+        for (auto &n : nodes) {
+            stack.push_back(n);
+            clobber(stack);
+        }
+        for (unsigned k = 0; k < batch; ++k) {
+            stack.pop_back();
+            clobber(stack);
+        }
+    }), batch);
+
+    Coro coro;
+    store(coroResume, measure([&](unsigned) {
+        for (unsigned k = 0; k < batch; ++k) {
+            coro.step();
+            clobber(coro);
+        }
+    }), batch);
+
+    // Both diffs are out of line, called the same way on the same buffers
+    alignas(4) std::array<std::byte, 48> bufs[2] = {};
+    bufs[1].fill(std::byte{0xFF});
+    alignas(4) std::array<std::byte, 48> copy{};
+    store(diff48, measure([&](unsigned i) {
+        auto d = diffCopy(copy, bufs[i & 1]);
+        clobber(d);
+    }));
+    store(diff48Ref, measure([&](unsigned i) {
+        auto d = diffBytewise(copy, bufs[i & 1]);
+        clobber(d);
+    }));
+
+    src4392::Src4392 src{ src4392::SRC4392::Intgr{}, nullptr };
+    std::byte page{0x01};
+    store(lookup, measure([&](unsigned i) {
+        for (unsigned k = 0; k < batch; ++k) {
+            std::byte *ptr = src.getPtr((i * batch + k) & 0x7F, page);
+            clobber(ptr);
+        }
+    }), batch);
+
+    std::coroutine_handle<> slot;
+    unsigned count = 0;
+    if (auto t = taskLoop(slot, count); t.valid()) {
+        t.start();
+        store(taskResume, measure([&](unsigned) { slot.resume(); }));
+    }
+    store(taskCreate, measure([&](unsigned) {
+        auto t = taskEmpty(count);
+        t.start();
+    }));
+
+    // A request, and the completion of its transfer
+    SequenceCoro seq;
+    store(seqCoro, measure([&](unsigned) {
+        seq.pending = true;
+        seq.resume();
+        seq.resume();
+    }));
+    store(seqTask, measure([&](unsigned) {
+        seq.pending = true;
+        if (auto t = sequenceTask(seq, slot); t.valid()) {
+            t.start();
+            slot.resume();
+        }
+    }));
+
+    return std::as_writable_bytes(std::span(&results, 1));
+}
+
+/** @}*/
@@ -0,0 +1,59 @@
+/** @file
+ * Microbenchmarks of the building blocks on the per-block path.
+ *
+ * @addtogroup AES42HAT_bench
+ * @ingroup AES42HAT
+ * @{
+ */
+
+module;
+#include <cstddef>
+#include <cstdint>
+#include <span>
+export module bench;
+
+/** On-target microbenchmarks.
+ *
+ * The intrusive containers, the stackless coroutines and the register cache
+ * of the SRC4392 driver are all used for every received block. The C++20
+ * tasks are measured alongside the stackless coroutines, to weigh them for
+ * more complex protocol logic. Their cost per
+ * operation is measured here with the SysTick counter, with interrupts
+ * disabled, and after subtracting the cost of the empty measurement loop.
+ *
+ * The benchmarks run once at startup, when the firmware is built with the
+ * option AES42HAT_BENCH, and the results are exposed as a board control window.
+ */
+export namespace bench {
+
+/** Operations measured. */
+enum Item : uint8_t {
+    queuePushPop,       //!< QueueRing push_back() and pop_front()
+    queueRotate,        //!< QueueRing rotate() on a ring of 16
+    stackPushPop,       //!< StackRing push_back() and pop_back()
+    coroResume,         //!< Call and resume of a CORO_REENTER coroutine, up to the next CORO_YIELD
+    diff48,             //!< diffCopy() of a 48-byte block, all bytes changed
+    diff48Ref,          //!< The same diff with the former byte by byte loop and a 64-bit mask, for comparison
+    lookup,             //!< Src4392::getPtr() on page 1
+    taskResume,         //!< Resume of a task, up to the next co_await
+    taskCreate,         //!< Creation, start and destruction of a task, with its frame from the pool
+    seqCoro,            //!< The page 1 read sequence of a channel as a CORO_REENTER coroutine, from request to completion
+    seqTask,            //!< The same sequence as a task, created for the request
+    itemCount
+};
+
+/** Benchmark results. */
+struct Results {
+    uint16_t loop;                  //!< Cycles of the empty measurement loop per iteration
+    uint16_t cycles[itemCount];     //!< Cycles per operation, in units of 1/16 cycle
+};
+
+/** Run all benchmarks.
+ * This takes a few milliseconds.
+ * @return The results, for exposing them to the host
+ */
+std::span<std::byte> run();
+
+} // namespace
+
+//!@}
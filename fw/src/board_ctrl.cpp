@@ -0,0 +1,134 @@
+/** @file
+ * Board control register set on the I2C target interface.
+ * @addtogroup AES42HAT_ctrl
+ * @ingroup AES42HAT
+ * @{
+ */
+module;
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+module board_ctrl;
+import handler;
+
+static constexpr uint8_t firmwareVersion = 0x01;
+
+void BoardControl::attach(Window win, std::span<std::byte> data, Access access) {
+    if (win < windowCount)
+        windows_[win] = { data.data(), uint16_t(data.size()), access };
+}
+
+void BoardControl::attach(Command cmd, Handler &hdl) {
+    if (cmd < commandCount)
+        commands_[cmd] = &hdl;
+}
+
+bool BoardControl::select(uint8_t tgt) {
+    if ((tgt >> 1) != addr_)
+        return false;
+    expectReg_ = !(tgt & 0x01);
+    return true;
+}
+
+void BoardControl::deselect() {
+}
+
+uint8_t BoardControl::getTxByte() {
+    uint8_t val = read();
+    advance();
+    return val;
+}
+
+void BoardControl::putRxByte(uint8_t val) {
+    if (expectReg_) {
+        reg_ = val;
+        offset_ = reg_ >= regData ? reg_ - regData : 0;
+        expectReg_ = false;
+        return;
+    }
+    write(val);
+    advance();
+}
+
+uint8_t BoardControl::read() {
+    auto const &w = windows_[win_];
+    switch (reg_) {
+    case regWindow:
+        return win_;
+    case regSizeLo:
+        return uint8_t(w.size);
+    case regSizeHi:
+        return uint8_t(w.size >> 8);
+    case regReqMaskLo:
+        return uint8_t(req_.mask());
+    case regReqMaskHi:
+        return uint8_t(req_.mask() >> 8);
+    case regVersion:
+        return firmwareVersion;
+    default:
+        if (reg_ >= regData && offset_ < w.size)
+            return uint8_t(w.data[offset_]);
+        return 0;
+    }
+}
+
+void BoardControl::write(uint8_t val) {
+    switch (reg_) {
+    case regCommand:
+        command(val);
+        return;
+    case regWindow:
+        if (val < windowCount)
+            win_ = val;
+        return;
+    case regReqMaskLo:
+        req_.setMask((req_.mask() & 0xFF00) | val);
+        return;
+    case regReqMaskHi:
+        req_.setMask((req_.mask() & 0x00FF) | (val << 8));
+        return;
+    default:
+        if (auto const &w = windows_[win_]; reg_ >= regData && w.access == writable && offset_ < w.size)
+            w.data[offset_] = std::byte(val);
+        return;
+    }
+}
+
+void BoardControl::command(uint8_t cmd) {
+    switch (cmd) {
+    case cmdClearStats:
+#if HANDLER_PROFILE
+        Handler::clearProfile();
+#endif
+        for (auto const &w : windows_)
+            if (w.access == counters)
+                std::fill_n(w.data, w.size, std::byte{0});
+        return;
+    default:
+        if (cmd < commandCount && commands_[cmd])
+            commands_[cmd]->post();
+        return;
+    }
+}
+
+void BoardControl::advance() {
+    if (reg_ < regData)
+        ++reg_;         // stepping from regVersion to regData enters the window at offset 0
+    else
+        ++offset_;
+}
+
+BoardControl::BoardControl(uint8_t addr, ServiceRequest &req)
+    : req_{req}
+    , windows_{}
+    , commands_{}
+    , offset_{0}
+    , reg_{0}
+    , win_{0}
+    , addr_{addr}
+    , expectReg_{false}
+{
+}
+
+/** @}*/
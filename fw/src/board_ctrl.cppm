@@ -0,0 +1,124 @@
+/** @file
+ * Board control register set on the I2C target interface.
+ *
+ * @addtogroup AES42HAT_ctrl
+ * @ingroup AES42HAT
+ * @{
+ */
+
+module;
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+export module board_ctrl;
+import i2c_tgt_drv;
+import service_req;
+import handler;
+
+/** Board control registers.
+ *
+ * This is the register set the host accesses at the board control I2C
+ * address. A write transfer starts with a register address byte, like with
+ * the SRC4392 passthrough addresses, and both reads and writes auto-increment
+ * the register address.
+ *
+ * Addresses 0x00..0x7F are individual registers. Addresses from 0x80 onwards
+ * access a data window, which exposes a block of memory that is owned by some
+ * other part of the firmware, for example a set of statistics. The window is
+ * selected through a register. Address 0x80 is the start of the window, and
+ * auto-increment continues beyond address 0xFF up to the window size, so that
+ * the entire window can be read in a single burst.
+ *
+ * The callbacks run in interrupt context. Multi-byte values in a window may
+ * be updated while the host reads them.
+ */
+export class BoardControl : public lpc865::I2cTarget::Callback {
+public:
+    /** Registers. */
+    enum Register : uint8_t {
+        regCommand  = 0x00,     //!< Command register (write), see enum Command
+        regWindow   = 0x01,     //!< Window selection (see enum Window)
+        regSizeLo   = 0x02,     //!< Size of the selected window, low byte (read only)
+        regSizeHi   = 0x03,     //!< Size of the selected window, high byte (read only)
+        regReqMaskLo = 0x04,    //!< Service request mask, low byte
+        regReqMaskHi = 0x05,    //!< Service request mask, high byte
+        regVersion  = 0x7F,     //!< Firmware version (read only)
+        regData     = 0x80,     //!< Start of the window data
+    };
+
+    /** Commands written to the command register. */
+    enum Command : uint8_t {
+        cmdNone         = 0x00,
+        cmdClearStats   = 0x01, //!< Reset statistics, i.e. handler profiling data and counter windows
+        cmdSave         = 0x02, //!< Save the configuration in flash
+        commandCount
+    };
+
+    /** Data windows. */
+    enum Window : uint8_t {
+        winProfile,             //!< Handler profiling data
+        winPhantom,             //!< Phantom voltage readout
+        winSpi,                 //!< SPI traffic statistics
+        winChannels,            //!< Channel block and protocol statistics
+        winBench,               //!< Microbenchmark results
+        winStatus,              //!< Decoded receive status of the channels
+        winEvents,              //!< Receiver event counters and log
+        winRatio,               //!< SRC ratio drift statistics
+        winTasks,               //!< Task frame pool statistics
+        winBringUp,             //!< SRC4392 bring-up times
+        winConfig,              //!< Config store statistics
+        winCaptures,            //!< FTM0 capture timing
+        winSpiPlan,             //!< SPI clock plan and bus headroom
+        windowCount
+    };
+
+    /** Host access to a window. */
+    enum Access : uint8_t {
+        readOnly,               //!< Host may only read
+        writable,               //!< Host may read and write
+        counters,               //!< Host may only read, and cmdClearStats clears the memory
+    };
+
+    /** Attach a block of memory to a window.
+     * @param win Window number
+     * @param data The memory to expose
+     * @param access Host access to the memory
+     */
+    void attach(Window win, std::span<std::byte> data, Access access = readOnly);
+
+    /** Attach a handler to a command, which is posted when the host issues it.
+     * This is for commands that can't be carried out in interrupt context.
+     */
+    void attach(Command cmd, Handler &hdl);
+
+    bool select(uint8_t) override;
+    void deselect() override;
+    uint8_t getTxByte() override;
+    void putRxByte(uint8_t) override;
+
+    BoardControl(uint8_t addr, ServiceRequest &req);
+
+private:
+    struct Block {
+        std::byte *data;
+        uint16_t size;
+        Access access;
+    };
+
+    uint8_t read();
+    void write(uint8_t val);
+    void command(uint8_t cmd);
+    void advance();
+
+    ServiceRequest &req_;
+    std::array<Block, windowCount> windows_;
+    std::array<Handler *, commandCount> commands_;  //!< Handlers attached to commands
+    uint16_t offset_;           //!< Byte offset into the window
+    uint8_t reg_;               //!< Current register address
+    uint8_t win_;               //!< Selected window
+    uint8_t const addr_;        //!< 7-bit I2C address
+    bool expectReg_;            //!< True when expecting register address byte from I2C
+};
+
+//!@}
@@ -0,0 +1,85 @@
+/** @file
+ * Logging of FTM capture values by DMA.
+ * @addtogroup LPC865_ftm
+ * @ingroup LPC865
+ * @{
+ */
+module;
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+module capture_log;
+
+size_t lpc865::CaptureLog::read(unsigned idx, uint32_t &pos, std::span<uint16_t> out) const {
+    // The half after the one published last is being overwritten by now,
+    // so only the last published half is safe.
+    uint32_t end = out_[idx].edges;
+    if (end - pos > half)
+        pos = end - half;
+    size_t n = std::min<size_t>(end - pos, out.size());
+    for (size_t i = 0; i < n; ++i)
+        out[i] = ring_[idx][(pos + i) % ringSize];
+    pos += n;
+    return n;
+}
+
+/** Publish a full half of a ring, and evaluate its intervals. */
+void lpc865::CaptureLog::publish(unsigned idx, unsigned h) {
+    auto &o = out_[idx];
+    uint16_t const *cap = ring_[idx] + h * half;
+    uint16_t prev = o.last;
+    uint16_t lo = UINT16_MAX;
+    uint16_t hi = 0;
+    // The first interval of all spans back to the power-on value of the
+    // counter, so it is left out.
+    for (unsigned i = o.edges == 0 ? 1 : 0; i < half; ++i) {
+        uint16_t iv = cap[i] - (i == 0 ? prev : cap[i - 1]);
+        lo = std::min(lo, iv);
+        hi = std::max(hi, iv);
+    }
+    o.minInterval = lo;
+    o.maxInterval = hi;
+    o.last = cap[half - 1];
+    o.edges += half;
+    next_[idx] = uint8_t(h ^ 1);
+}
+
+void lpc865::CaptureLog::act() {
+    for (unsigned i = 0; i < par_.count; ++i) {
+        uint8_t flags = dma_.takeFlags(par_.ring[i].dmachan);
+        if (flags == 0)
+            continue;
+        if (flags == 3)
+            ++out_[i].overruns;     // the half published first may be overwritten already
+        // Bit 0 is the first half, bit 1 the second. Publish them in order,
+        // starting with the one that is due.
+        while (flags) {
+            unsigned h = flags & (1u << next_[i]) ? next_[i] : next_[i] ^ 1;
+            flags &= ~(1u << h);
+            publish(i, h);
+        }
+    }
+}
+
+lpc865::CaptureLog::CaptureLog(Parameters const &par, Ftm &ftm, Dma &dma)
+    : Handler{readySet}
+    , par_{par}
+    , dma_{dma}
+    , link_{}
+    , ring_{}
+    , next_{}
+    , out_{}
+{
+    for (unsigned i = 0; i < par.count && i < maxRings; ++i) {
+        auto const &r = par.ring[i];
+        // The FTM channel isn't a DMA request of the channel, so the
+        // transfers are paced by the hardware trigger alone.
+        Dma::Per per{ .chan = r.dmachan, .width = 1, .dest = 0, .hwtrig = 1, .trigpol = 1, .trigburst = 1, .noreq = 1 };
+        Dma::Mem mem{ .chan = r.dmachan, .inc = 1, .setintA = 1, .setintB = 1 };
+        if (dma_.setup(per, ftm.captureAddress(r.ftmch), this))
+            dma_.startRing(mem, ring_[i], ringSize, link_[i]);
+    }
+}
+
+/** @}*/
@@ -0,0 +1,97 @@
+/** @file
+ * Logging of FTM capture values by DMA.
+ *
+ * @addtogroup LPC865_ftm
+ * @ingroup LPC865
+ * @{
+ */
+
+module;
+#include <cstddef>
+#include <cstdint>
+#include <span>
+export module capture_log;
+import handler;
+import dma_drv;
+import ftm_drv;
+
+export namespace lpc865 {
+
+/** Capture log.
+ *
+ * Reading a capture register in an interrupt service routine loses edges,
+ * whenever the interrupt is disabled or delayed by more than the time to the
+ * next edge on the same channel. Here, each capture event of an FTM channel
+ * triggers a DMA transfer instead, which appends the capture value to a ring
+ * buffer of its own, without CPU involvement. So every edge is logged.
+ *
+ * Each ring is split into two halves. When a half is full, the DMA interrupt
+ * posts the log as a handler, which publishes the half to the consumers, and
+ * updates the timing statistics. Consumers like phase tracking or sampling
+ * rate detection read the published captures at their own pace, each with its
+ * own read position. The captures of a half are published a few blocks after
+ * the fact, so they are for analysis, not for reacting to an edge.
+ */
+class CaptureLog : public Handler {
+public:
+    static constexpr unsigned maxRings = 6;     //!< Number of FTM channels supported
+    static constexpr unsigned ringSize = 16;    //!< Captures per ring, in two halves
+    static constexpr unsigned half = ringSize / 2;
+
+    /** Operating parameters. */
+    struct Parameters {
+        uint8_t count;          //!< Number of rings
+        struct Ring {
+            uint8_t ftmch;      //!< FTM channel, in a capture mode with DMA enabled
+            uint8_t dmachan;    //!< DMA channel, triggered by the FTM channel, see DMA_ITRIG_INMUX in sysinit()
+        } ring[maxRings];
+    };
+
+    /** Timing statistics of a ring, in FTM ticks. */
+    struct Timing {
+        uint32_t edges;         //!< Captures published so far
+        uint16_t last;          //!< Most recent capture published
+        uint16_t minInterval;   //!< Shortest interval between edges in the last half
+        uint16_t maxInterval;   //!< Longest interval between edges in the last half
+        uint16_t overruns;      //!< Times the handler found both halves full
+    };
+
+    /** Get the timing statistics of all rings, for exposing them to the host. */
+    std::span<std::byte> timing() {
+        return std::as_writable_bytes(std::span(out_, par_.count));
+    }
+
+    /** Number of captures published in a ring so far. This wraps around. */
+    uint32_t published(unsigned idx) const { return out_[idx].edges; }
+
+    /** Copy the captures of a ring from a read position on.
+     * @param idx Ring index
+     * @param pos Read position of the consumer, which is advanced. It starts
+     *        at 0, or at published() to skip the earlier captures.
+     * @param out Buffer for the captures
+     * @return Number of captures copied
+     *
+     * Captures that have been overwritten since they were published are
+     * skipped, so the consumer can tell from the advance of pos how many it
+     * has lost.
+     */
+    size_t read(unsigned idx, uint32_t &pos, std::span<uint16_t> out) const;
+
+    void act() override;
+
+    CaptureLog(Parameters const &par, Ftm &ftm, Dma &dma);
+
+private:
+    void publish(unsigned idx, unsigned h);
+
+    Parameters const &par_;
+    Dma &dma_;
+    alignas(16) Dma::Descriptor link_[maxRings];    //!< Descriptors for the second halves
+    uint16_t ring_[maxRings][ringSize];
+    uint8_t next_[maxRings];    //!< Half to be published next
+    Timing out_[maxRings];
+};
+
+} // namespace
+
+//!@}
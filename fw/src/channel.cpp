@@ -6,11 +6,258 @@
  */
 module;
 #include <cstddef>
+#include <bit>
 #include <cstdint>
+#include <cstring>
 #include "externs.h"
+#include "ramfunc.h"
 #include "coroutine.hpp"
 module channel;
 
+static Channel::Stats channelStats[Channel::maxChannels] = {};
+
+static Channel::Status channelStatus[Channel::maxChannels] = {};
+
+static Channel::Events channelEvents = {};
+
+/** The channels by number, for finding the ones to chain reads with. */
+static Channel *channelList[Channel::maxChannels] = {};
+
+/** The channel holding its status read for others to join, if any. */
+static Channel *volatile holder = nullptr;
+
+/** Receiver status bits of each event kind, status register 1 in the low byte,
+ * status register 2 in the high byte.
+ */
+static constexpr uint16_t eventBits[Channel::Events::kindCount] = {
+    src4392::rxUnlock,
+    src4392::rxParity << 8,
+    src4392::rxValidity << 8,
+    src4392::rxBiphase << 8,
+    src4392::rxSlip << 8,
+};
+
+std::span<std::byte> Channel::stats() {
+    return std::as_writable_bytes(std::span(channelStats));
+}
+
+std::span<std::byte> Channel::status() {
+    return std::as_writable_bytes(std::span(channelStatus));
+}
+
+std::span<std::byte> Channel::events() {
+    return std::as_writable_bytes(std::span(&channelEvents, 1));
+}
+
+/** Find lost block interrupts, by comparing the interval since the previous
+ * block start with the learned block period.
+ *
+ * The FTM0 capture is taken by the hardware on every edge of the interrupt
+ * line, also while the pin interrupt is disabled. So a block whose interrupt
+ * was lost shows up as an interval of several periods. Intervals of about one
+ * period train the estimate, so that it follows slow changes of the sampling
+ * rate. The timestamps wrap around after 65536 ticks, which limits the gaps
+ * that can be measured.
+ */
+void Channel::trackPeriod() {
+    uint16_t interval = capt_ - lastBlock_;
+    bool prev = havePrev_;
+    lastBlock_ = capt_;
+    havePrev_ = true;
+    if (!prev || interval == 0)
+        return;
+    uint32_t x = uint32_t(interval) << 4;
+    if (period_ == 0) {
+        period_ = x;
+    } else if (uint32_t k = (x + period_ / 2) / period_; k == 1) {
+        period_ = uint32_t(int32_t(period_) + (int32_t(x) - int32_t(period_)) / 8);
+    } else if (k > 1) {
+        channelStats[in_.in.addr].missed += k - 1;
+    }
+    channelStats[in_.in.addr].period = uint16_t((period_ + 8) >> 4);
+}
+
+/** Account for the time the page 1 read took since the block start.
+ * It must complete within a block period, before the chip flips its buffers.
+ */
+void Channel::checkLatency() {
+    auto &st = channelStats[in_.in.addr];
+    uint16_t latency = ftm_.getCount() - capt_;
+    if (latency > st.worstLatency)
+        st.worstLatency = latency;
+    if (period_ != 0 && (uint32_t(latency) << 4) > period_)
+        ++st.late;
+}
+
+/** Hold the status read for the block starts of other channels that are due
+ * within coalesceWindow of the interrupt, as found from their learned periods.
+ * @return true if the timer match resumes the channel when the window ends
+ */
+bool Channel::hold() {
+    if (holder)
+        return false;
+    bool due = false;
+    for (unsigned n = 0; n < maxChannels; ++n) {
+        Channel *p = channelList[n];
+        if (!p || p == this || !p->receiving_ || p->period_ == 0 || p->rstat_)
+            continue;
+        uint16_t next = p->lastBlock_ + uint16_t((p->period_ + 8) >> 4);
+        due = due || uint16_t(next - evCapt_ + coalesceWindow) <= 2 * coalesceWindow;
+    }
+    if (!due || !ftm_.armMatch(in_.mch, evCapt_ + coalesceWindow, resume_))
+        return false;
+    holder = this;
+    return true;
+}
+
+/** Whether the status read waits for the channel holding its own, which
+ * takes it along. The holder clears itself before it takes the others along,
+ * so a status read found held is never left behind.
+ */
+RAMFUNC bool Channel::held() const {
+    Channel *h = holder;
+    return rstat_ && h && h != this
+        && uint16_t(evCapt_ - h->evCapt_ + coalesceWindow) <= 2 * coalesceWindow;
+}
+
+/** Take along the other channels waiting for the same read.
+ * @param flag Request flag of the read, which is cleared in the channels taken
+ * @param stamp Timestamp to compare
+ * @return Bitmap of the channels taken, which are busy until release()
+ */
+uint8_t Channel::gather(bool volatile Channel::*flag, uint16_t Channel::*stamp) {
+    uint8_t peers = 0;
+    for (unsigned n = 0; n < maxChannels; ++n) {
+        Channel *p = channelList[n];
+        if (!p || p == this || p->busy_ || !(p->*flag))
+            continue;
+        if (uint16_t(p->*stamp - this->*stamp + coalesceWindow) > 2 * coalesceWindow)
+            continue;
+        p->busy_ = true;
+        p->*flag = false;
+        peers |= 1u << n;
+        ++channelStats[n].coalesced;
+    }
+    return peers;
+}
+
+/** Get channel n if its read is chained to the running one. */
+Channel *Channel::peer(unsigned n) const {
+    return peers_ & (1u << n) ? channelList[n] : nullptr;
+}
+
+/** Evaluate the status read, and accept the next interrupt. */
+void Channel::finishStatus() {
+    classify();
+    pint_.enable(in_.irq, 4);
+}
+
+/** Publish the page 1 read. */
+void Channel::finishPage1() {
+    checkLatency();
+    bool cs = bool(src_.commitCS());
+    bool u = bool(src_.commitU());
+    if (cs)
+        decodeCS();
+    if (u)
+        ++channelStatus[in_.in.addr].uSeq;
+    if (cs || u)
+        decodeMic();
+    // A new capture means that the chip has flipped its buffers
+    // meanwhile, so the data may be torn between two blocks.
+    if (ftm_.getCapture(in_.tch) != capt_)
+        ++channelStats[in_.in.addr].straddles;
+    uint8_t bad = src_.checkRxCS();
+    channelStatus[in_.in.addr].crcBad = bad;
+    channelStats[in_.in.addr].crcErrors += std::popcount(bad);
+}
+
+/** End a read chained to another channel's, and pick up what came meanwhile.
+ * @param along The running channel takes the page 1 read along next, so a
+ *        request for it alone needs no dispatch of its own
+ */
+void Channel::release(bool along) {
+    busy_ = false;
+    bool alone = pg1rd_ && !initwr_ && !rstat_ && !subrd_ && !pg0wb_ && !pg2wb_;
+    if (pending() && !(along && alone))
+        post();
+}
+
+/** Evaluate the receiver status after an interrupt. */
+void Channel::classify() {
+    uint16_t rx = src_.rxStatus1() | src_.rxStatus2() << 8;
+    auto n = in_.in.addr;
+    if (rx & src4392::rxUnlock) {
+        // The rate may change while the receiver is unlocked.
+        receiving_ = false;
+        havePrev_ = false;
+        period_ = 0;
+    } else if (rx & src4392::rxBlockStart) {
+        receiving_ = true;
+    }
+    if (rx & src4392::rxBlockStart) {
+        capt_ = evCapt_;
+        delta_ = evDelta_;
+        ++channelStats[n].blocks;
+        trackPeriod();
+        pg1rd_ = true;
+    }
+    uint8_t kinds = 0;
+    for (unsigned k = 0; k < Events::kindCount; ++k) {
+        if (rx & eventBits[k]) {
+            kinds |= 1u << k;
+            if (auto &c = channelEvents.counts[n][k]; c != UINT16_MAX)
+                ++c;
+        }
+    }
+    if (rx & src4392::rxQChange || src_.nonPcm() != nonPcm_)
+        subrd_ = true;
+    if (kinds) {
+        auto &ev = channelEvents;
+        ev.log[ev.next % Events::logSize] = { channelStats[n].blocks, evCapt_, uint8_t(n), kinds };
+        ev.next = (ev.next + 1) % Events::logSize;
+    }
+}
+
+/** Publish the stream type after the subcode registers have been read,
+ * and bypass the SRC for compressed data.
+ */
+void Channel::updateStream() {
+    auto &st = channelStatus[in_.in.addr];
+    nonPcm_ = src_.nonPcm();
+    Stream stream = nonPcm_ & src4392::npcmIec61937 ? streamIec61937
+                  : nonPcm_ & src4392::npcmDtsCd ? streamDtsCd
+                  : streamPcm;
+    st.pc = src_.burstPc();
+    st.pd = src_.burstPd();
+    ++st.subSeq;
+    if (stream != st.stream) {
+        st.stream = stream;
+        if (src_.bypass(stream != streamPcm))
+            pg0wb_ = true;
+    }
+}
+
+/** Decode the channel status after it has changed. */
+void Channel::decodeCS() {
+    auto &st = channelStatus[in_.in.addr];
+    st.cs[0] = src_.summarizeRxCS(0);
+    st.cs[1] = src_.summarizeRxCS(1);
+    ++st.csSeq;
+}
+
+/** Decode the microphone status after the channel status or user data has
+ * changed. The counter only counts actual changes of the status, not every
+ * change of the user data.
+ */
+void Channel::decodeMic() {
+    auto &st = channelStatus[in_.in.addr];
+    aes3::MicStatus mic = src_.summarizeRxMic();
+    if (std::memcmp(&mic, &st.mic, sizeof mic) != 0) {
+        st.mic = mic;
+        ++st.micSeq;
+    }
+}
 
 bool Channel::select(uint8_t tgt) {
     print("S");
@@ -51,61 +298,165 @@ void Channel::putRxByte(uint8_t val) {
     }
 }
 
-void Channel::isr() {
-    uint16_t ts1 = ftm_.getCount();
+RAMFUNC void Channel::isr() {
     uint16_t capt = ftm_.getCapture(in_.tch);
     uint16_t ref = ftm_.getCapture(in_.rch);
-    uint16_t ts2 = ftm_.getCount();
-    delta_ = capt - ref;
+    evDelta_ = capt - ref;
+    evCapt_ = capt;
     pint_.disable(in_.irq);
-    pg1rd_ = true;
-    post();
+    rstat_ = true;
+    if (!held())
+        post();
 }
 
 void Channel::act() {
+    if (busy_ || held())
+        return;
+    busy_ = true;
+    resume();
+}
+
+/** Run the SPI sequence for one request, then look for the next one. */
+void Channel::resume() {
     CORO_REENTER(coro_) {
-        if (rstat_) {
+        if (initwr_) {
+            initwr_ = false;
+            src_.resetPage();
+            if (initAll_ || restored_)
+                src_.writeRegs();
+            else
+                src_.writeOverrides(in_.overrides);
+            if (restored_) {
+                src_.sealTxCS();
+                src_.writeCS();
+                src_.writeU();
+            }
+            if (src_.pending()) {
+                CORO_YIELD src_.submit(spiq_);
+            }
+            configured_ = true;
+            print("I");
+        } else if (rstat_) {
+            if (hold()) {
+                CORO_YIELD;
+                holder = nullptr;
+            }
             rstat_ = false;
-            CORO_YIELD src_.readRxStatus(spiq_);
+            peers_ = gather(&Channel::rstat_, &Channel::evCapt_);
+            for (unsigned n = 0; n < maxChannels; ++n) {
+                if (Channel *p = peer(n)) {
+                    p->src_.readRxStatus();
+                    p->src_.submit(spiq_, false);
+                }
+            }
+            src_.readRxStatus();
+            CORO_YIELD src_.submit(spiq_);
+            finishStatus();
+            for (unsigned n = 0; n < maxChannels; ++n) {
+                if (Channel *p = peer(n)) {
+                    p->finishStatus();
+                    p->release(pg1rd_ && uint16_t(p->capt_ - capt_ + coalesceWindow) <= 2 * coalesceWindow);
+                }
+            }
             print("S");
         } else if (pg1rd_) {
             pg1rd_ = false;
-            CORO_YIELD src_.switchPage(spiq_, 0x01);
-            CORO_YIELD src_.readCS(spiq_);
-            CORO_YIELD src_.readU(spiq_);
-            CORO_YIELD src_.switchPage(spiq_, 0x00);
+            peers_ = gather(&Channel::pg1rd_, &Channel::capt_);
+            for (unsigned n = 0; n < maxChannels; ++n) {
+                if (Channel *p = peer(n)) {
+                    p->src_.readCS();
+                    p->src_.readU();
+                    p->src_.submit(spiq_, false);
+                }
+            }
+            src_.readCS();
+            src_.readU();
+            CORO_YIELD src_.submit(spiq_);
+            finishPage1();
+            for (unsigned n = 0; n < maxChannels; ++n) {
+                if (Channel *p = peer(n)) {
+                    p->finishPage1();
+                    p->release();
+                }
+            }
             print("R");
+        } else if (subrd_) {
+            subrd_ = false;
+            src_.readSubchannel();
+            CORO_YIELD src_.submit(spiq_);
+            updateStream();
         } else if (pg0wb_) {
             pg0wb_ = false;
-            CORO_YIELD src_.writeRegs(spiq_);
+            src_.writeRegs();
+            CORO_YIELD src_.submit(spiq_);
             print("C");
         } else if (pg2wb_) {
             pg2wb_ = false;
-            CORO_YIELD src_.readTxStatus(spiq_);
-            CORO_YIELD src_.switchPage(spiq_, 0x02);
-            CORO_YIELD src_.writeCS(spiq_);
-            CORO_YIELD src_.writeU(spiq_);
-            CORO_YIELD src_.switchPage(spiq_, 0x00);
+            src_.sealTxCS();
+            src_.readTxStatus();
+            src_.writeCS();
+            src_.writeU();
+            CORO_YIELD src_.submit(spiq_);
             print("T");
+        } else if (ratrd_ && spiq_.idle()) {
+            ratrd_ = false;
+            src_.readRatio();
+            CORO_YIELD src_.submit(spiq_);
+            ratio_ = src_.ratio();
+            ++ratioSeq_;
         }
-        pint_.enable(in_.irq, 4);
+        channelStats[in_.in.addr].savedTransfers = src_.savedTransfers();
+        channelStats[in_.in.addr].savedBytes = src_.savedBytes();
     }
+    if (!coro_.is_complete())
+        return;         // waiting for a transfer
+    coro_ = {};
+    busy_ = false;
+    // A pending ratio read waits for the next request, so that it doesn't
+    // spin while other channels keep the SPI busy.
+    if (pending())
+        post();
 }
 
-Channel::Channel(Integration const &in, lpc865::SpiQueue &spiq, lpc865::Ftm &ftm, lpc865::Pint &pint)
-    : addr_{0}
+Channel::Channel(Integration const &in, lpc865::SpiQueue &spiq, lpc865::Ftm &ftm, lpc865::Pint &pint,
+                 std::span<std::byte const> saved)
+    : Handler{readySet}
+    , addr_{0}
     , expectReg_{false}
     , page_{0}
+    , busy_{false}
+    , peers_{0}
+    , initwr_{false}
+    , initAll_{false}
+    , configured_{false}
+    , receiving_{false}
+    , restored_{false}
     , pg0wb_{false}
     , pg2wb_{false}
     , rstat_{false}
     , pg1rd_{false}
+    , subrd_{false}
+    , nonPcm_{0}
+    , ratrd_{false}
+    , ratioSeq_{0}
+    , ratio_{0}
+    , period_{0}
+    , lastBlock_{0}
+    , havePrev_{false}
+    , delta_{0}
+    , capt_{0}
+    , evCapt_{0}
+    , evDelta_{0}
     , in_{in}
     , spiq_{spiq}
     , ftm_{ftm}
     , pint_{pint}
-    , src_{in.in, this}
+    , resume_{*this}
+    , src_{in.in, &resume_}
 {
-    src_.updateRegs(in_.init);
+    src_.initRegs(in_.base, in_.overrides);
+    if (saved.size() == maxChannels * configSize)
+        restored_ = src_.restore(saved.subspan(in_.in.addr * configSize, configSize));
+    channelList[in_.in.addr] = this;
     pint_.attach(in_.irq, 4, *this);
 }
@@ -9,17 +9,20 @@
 module;
 #include <cstddef>
 #include <cstdint>
-#include <initializer_list>
+#include <span>
 #include "coroutine.hpp"
 export module channel;
 import i2c_tgt_drv;
 import nvic_drv;
 import handler;
 import src4392_drv;
+import aes3;
 import SRC4392;
 import ftm_drv;
 import pint_drv;
+import spi_drv;
 import spi_queue;
+import variant;
 
 /** Object representing an AES42 channel.
  *
@@ -34,8 +37,42 @@ import spi_queue;
  * - A phase measurement was taken by FTM0
  * - A new block of channel status and user data has been received
  *
- * This interrupt triggers a sequence of SPI read transfers to copy the
- * receive status, the CS data and the U-bit data to the buffers in src_
+ * Receiver events like loss of lock, parity or bi-phase errors share the same
+ * interrupt pin. The interrupt service routine can't tell them apart, since
+ * that needs an SPI access, so it only takes the timestamp and requests the
+ * receiver status registers to be read. The status tells whether a block has
+ * started, and only then a sequence of SPI read transfers copies the CS data
+ * and the U-bit data to the buffers in src_. Other events are counted and
+ * logged, see Events. Their interrupts are programmed for the rising edge, so
+ * that a condition which persists, like a lost lock, reports once and is
+ * cleared by the status read. In level mode it would keep the interrupt line
+ * low, and every re-enabled pin interrupt would trigger another status read.
+ *
+ * The status read includes the non-PCM detection status. When it changes, or
+ * the Q-subcode has changed, the subcode and burst preamble registers are
+ * read, and the stream type is published. While compressed data is received,
+ * the audio ports are switched from the SRC to the DIR, so that the data
+ * passes unaltered.
+ *
+ * The SRC ratio is sampled on request. It comes last, and is only read while
+ * the SPI queue is idle, so that it fits in between the block fetches.
+ *
+ * The SPI transfers of one sequence are submitted as one batch, which
+ * completes in the context of the SPI queue. Sequences don't overlap: A
+ * request that arrives while a sequence is running is picked up when it ends.
+ *
+ * Receivers locked to the same source start their blocks at nearly the same
+ * time. The channel that gets to its status or page 1 read first then takes
+ * along the other channels waiting for the same read, if their timestamps are
+ * within coalesceWindow of its own. Their batches are chained in front of its
+ * own, and only the last one has a completion handler, which finishes the
+ * read for all of them. The others are marked busy meanwhile, as if they ran
+ * a sequence of their own. As a status read takes less time than the
+ * interrupts of locked receivers are apart, the first channel holds its status
+ * read until coalesceWindow after its interrupt, with a timer match, if the
+ * learned period of another channel has its block start due by then. One
+ * channel holds at a time, and the channels whose interrupts fall into its
+ * window wait for it to take them along.
  *
  * The channel is also attached to the I2C target interface, so that the
  * host can set and get register settings of the SRC4392. The host has
@@ -43,12 +80,136 @@ import spi_queue;
  */
 export class Channel : public lpc865::I2cTarget::Callback, public arm::Interrupt, public Handler {
 public:
+    static constexpr unsigned maxChannels = variant.channels;  //!< Number of SRC4392 channels fitted
+
+    /** Block and protocol statistics of a channel. Counters wrap around.
+     * Times are in FTM0 ticks.
+     */
+    struct Stats {
+        uint32_t blocks;        //!< Receive block interrupts
+        uint16_t straddles;     //!< Page 1 reads that overlapped with the start of the next block
+        uint16_t savedTransfers;//!< SPI transfers saved by the batch optimization
+        uint16_t crcErrors;     //!< Received channel status blocks with a wrong CRCC
+        uint16_t missed;        //!< Blocks whose interrupt was lost, found from gaps in the timestamps
+        int32_t savedBytes;     //!< SPI bytes saved by the batch optimization, may be negative
+        uint16_t late;          //!< Page 1 reads that completed after the next block had started
+        uint16_t worstLatency;  //!< Longest time from a block start to the completion of its page 1 read
+        uint16_t period;        //!< Learned block period, 0 while unknown
+        uint16_t coalesced;     //!< Status and page 1 reads chained to those of another channel
+    };
+
+    /** Type of the received stream. */
+    enum Stream : uint8_t {
+        streamPcm,              //!< Linear PCM audio
+        streamIec61937,         //!< Compressed data with IEC 61937 burst preambles
+        streamDtsCd,            //!< DTS CD/LD stream
+    };
+
+    /** Decoded receive status of a channel. */
+    struct Status {
+        aes3::Summary cs[2];    //!< Channel status summary of subchannels A and B
+        uint8_t csSeq;          //!< Incremented whenever the channel status has changed
+        uint8_t uSeq;           //!< Incremented whenever the user data has changed
+        uint8_t crcBad;         //!< Subchannels with a wrong CRCC in the last block (bit 0: A, bit 1: B)
+        uint8_t stream;         //!< Stream type, see Stream
+        uint16_t pc;            //!< Burst preamble Pc, the data type is in bits 0..4
+        uint16_t pd;            //!< Burst preamble Pd, the burst length
+        uint8_t subSeq;         //!< Incremented whenever the burst preamble or Q-subcode has been read
+        uint8_t micSeq;         //!< Incremented whenever the microphone status has changed
+        uint8_t reserved[2];
+        aes3::MicStatus mic;    //!< AES42 microphone status, from the user data of subchannel A
+    };
+
+    /** Receiver events of all channels.
+     * Each counter counts the occurrences of a condition, not the status
+     * reads that found it active. The counters saturate instead of wrapping
+     * around. The log keeps the
+     * most recent events, and can be read in the same transaction.
+     */
+    struct Events {
+        /** Kinds of receiver events. */
+        enum Kind : uint8_t {
+            evUnlock,           //!< Receiver PLL lost lock
+            evParity,           //!< Parity error
+            evValidity,         //!< Validity bit set
+            evBiphase,          //!< Bi-phase coding error
+            evSlip,             //!< Output slip or repeat
+            kindCount
+        };
+
+        /** Log entry. */
+        struct Entry {
+            uint32_t block;     //!< Block count of the channel when the event was handled
+            uint16_t capture;   //!< FTM0 timestamp of the interrupt
+            uint8_t channel;    //!< Channel number
+            uint8_t kinds;      //!< Bitmap of the event kinds, bit n for Kind n
+        };
+
+        static constexpr unsigned logSize = 16;
+
+        uint16_t counts[maxChannels][kindCount];    //!< Events per channel and kind
+        uint8_t next;           //!< Index of the log entry to be written next
+        uint8_t reserved[3];
+        Entry log[logSize];     //!< Ring of the most recent events
+    };
+
+    /** Planned SPI bus load of the block transfers. It is for the worst case
+     * of all channels receiving and transmitting a block each per block
+     * period, at the clocks planned for reads and writes.
+     */
+    struct Budget {
+        uint32_t readHz;        //!< SPI clock of reads
+        uint32_t writeHz;       //!< SPI clock of writes
+        uint16_t busyUs;        //!< Bus time per block period, including the setup of each transfer
+        uint16_t reserved;
+        struct Rate {
+            uint32_t hz;        //!< Sampling rate
+            uint16_t periodUs;  //!< Block period
+            int16_t headroom;   //!< Share of the block period left, in 0.1 %, negative if it doesn't fit
+        } rates[6];
+    };
+
+    /** CPU time from the end of one SPI transfer to the start of the next,
+     * for the interrupt, the queue handler and the DMA setup. This is an
+     * estimate, to be checked with the handler profiler.
+     */
+    static constexpr uint32_t setupNs = 5000;
+
+    /** Compute the bus load for the planned clocks.
+     * @param rd Plan of the reads
+     * @param wr Plan of the writes
+     */
+    static constexpr Budget budget(lpc865::Spi::Plan const &rd, lpc865::Spi::Plan const &wr) {
+        // Per channel and block: the status, page 1 and transmit status
+        // reads, and four page switches and the channel status and user data
+        // writes, each with the instruction and dummy byte.
+        constexpr uint32_t reads[] = { 2 + 4, 2 + 0x70, 2 + 1 };
+        constexpr uint32_t writes[] = { 2 + 1, 2 + 1, 2 + 1, 2 + 1, 2 + 48, 2 + 48 };
+        constexpr uint32_t rates[] = { 44100, 48000, 88200, 96000, 176400, 192000 };
+        uint32_t ns = 0;
+        for (auto b : reads)
+            ns += rd.ns(b) + setupNs;
+        for (auto b : writes)
+            ns += wr.ns(b) + setupNs;
+        ns *= maxChannels;
+        Budget bu{ rd.hz, wr.hz, uint16_t((ns + 999) / 1000), 0, {} };
+        unsigned i = 0;
+        for (auto hz : rates) {
+            auto period = uint32_t(192ull * 1000000000u / hz);
+            bu.rates[i++] = { hz, uint16_t((period + 500) / 1000),
+                              int16_t((int64_t(period) - ns) * 1000 / period) };
+        }
+        return bu;
+    }
+
     struct Integration {
         src4392::SRC4392::Intgr in;
         uint16_t irq:3;     //!< PINT channel for this channel
         uint16_t tch:3;     //!< Timer channel associated with this channel
         uint16_t rch:3;     //!< Reference channel in timer to compare timestamps with
-        std::initializer_list<std::byte> init;  //!< Initialization data for SRC registers
+        uint16_t mch:3;     //!< Timer channel in compare mode for holding reads, shared among channels
+        std::span<std::byte const> base;        //!< Initial values of page 0 addresses 0x01..0x33, shared among channels
+        std::span<src4392::Override const> overrides;   //!< Initial values of this channel that differ from base
     };
 
     bool select(uint8_t) override;
@@ -58,7 +219,7 @@ public:
 
     void isr() override;
 
-    /** Handles the receive side block event. */
+    /** Starts the next SPI sequence, unless one is running already. */
     void act() override;
 
     /** Write the cached register data to the SRC chip */
@@ -67,27 +228,144 @@ public:
         post();
     }
 
+    /** Write the initial register values to the SRC chip.
+     * @param all True to write all of page 0, false if the shared values
+     *        have been broadcast already, and only the overrides are missing
+     *
+     * The chip must have been set to page 0 beforehand. A restored
+     * configuration is always written as a whole, including page 2.
+     */
+    void initSrc(bool all) {
+        initAll_ = all;
+        configured_ = false;
+        receiving_ = false;
+        initwr_ = true;
+        post();
+    }
+
+    /** The chip has been set to page 0 by a broadcast, which is queued
+     * ahead of any batch the channel submits after this.
+     */
+    void resetPage() { src_.resetPage(); }
+
+    /** The initial register values have been written since the last initSrc(). */
+    bool configured() const { return configured_; }
+
+    /** A block has started since the last initSrc(), with the receiver locked. */
+    bool receiving() const { return receiving_; }
+
+    /** Get the integration data. */
+    Integration const &integration() const { return in_; }
+
     /** Handles the transmit side block event. */
     void handleTxBlock() {
         pg2wb_ = true;
         post();
     }
 
-    Channel(Integration const &in, lpc865::SpiQueue &spiq, lpc865::Ftm &ftm, lpc865::Pint &pint);
+    /** Request a sample of the SRC ratio readback.
+     * It is read at low priority, when no other transfer is pending.
+     */
+    void sampleRatio() {
+        ratrd_ = true;
+        post();
+    }
+
+    /** The most recent SRC ratio readback, registers 0x32 (high) and 0x33 (low). */
+    uint16_t ratio() const { return ratio_; }
+
+    /** Incremented with each ratio readback. */
+    uint8_t ratioSeq() const { return ratioSeq_; }
+
+    /** Get the statistics of all channels, in the order of their chip selects. */
+    static std::span<std::byte> stats();
+
+    /** Get the decoded receive status of all channels, in the order of their chip selects. */
+    static std::span<std::byte> status();
+
+    /** Get the receiver event counters and log. */
+    static std::span<std::byte> events();
+
+    /** Get the configuration set by the host, for saving it. */
+    auto config() { return src_.config(); }
+
+    /** Size of the configuration of one channel. */
+    static constexpr size_t configSize = src4392::Src4392::configSize;
+
+    /** Number of parts of the configuration of one channel. */
+    static constexpr size_t configParts = src4392::Src4392::configParts;
+
+    /** Create the channel.
+     * @param saved Saved configuration of all channels, in the order of their
+     *        chip selects, or empty. If present, it replaces the initial
+     *        register values, and the transmit channel status and user data.
+     */
+    Channel(Integration const &in, lpc865::SpiQueue &spiq, lpc865::Ftm &ftm, lpc865::Pint &pint,
+            std::span<std::byte const> saved = {});
 
 private:
+    /** Completion handler of the SPI batches. It is called synchronously
+     * by the SPI queue, or posted by the timer match that ends a hold.
+     */
+    struct Resume : Handler {
+        explicit Resume(Channel &chan) : chan_{chan} {}
+        void act() override { chan_.resume(); }
+        Channel &chan_;
+    };
+
+    /** Largest difference of the interrupt timestamps of channels whose
+     * reads are chained, in FTM0 ticks. It is 4 samples at the transmit
+     * sampling rate.
+     */
+    static constexpr uint16_t coalesceWindow = 32;
+
+    void resume();
+    bool hold();
+    bool held() const;
+    uint8_t gather(bool volatile Channel::*flag, uint16_t Channel::*stamp);
+    Channel *peer(unsigned n) const;
+    void finishStatus();
+    void finishPage1();
+    void release(bool along = false);
+    bool pending() const { return initwr_ || rstat_ || pg1rd_ || subrd_ || pg0wb_ || pg2wb_; }
+    void classify();
+    void trackPeriod();
+    void checkLatency();
+    void updateStream();
+    void decodeCS();
+    void decodeMic();
+
     uint8_t addr_;              //!< Current register address byte (MSB = INC bit) in I2C access
     bool expectReg_;            //!< True when expecting register address byte from I2C
     std::byte page_;            //!< Page in access from the I2C side
-    Coroutine<int8_t> coro_;    //!< Coroutine to read the RX status, CS and U data
+    Coroutine<int8_t> coro_;    //!< Coroutine running one SPI sequence
+    bool busy_;                 //!< A sequence is running, or a read chained to another channel's
+    uint8_t peers_;             //!< Channels whose reads are chained to the running one, bit n for channel n
+    bool volatile initwr_;      //!< Initial register values need writing to the chip
+    bool initAll_;              //!< All of page 0 needs writing, not only the overrides
+    bool configured_;           //!< Initial register values have been written
+    bool receiving_;            //!< Receiving blocks with the receiver locked
+    bool restored_;             //!< The configuration has been restored from a saved one
     bool volatile pg0wb_;       //!< Page 0 (Control registers) needs writing back to chip
     bool volatile pg2wb_;       //!< Page 2 (DIT CS&U data) needs writing back to chip
     bool volatile rstat_;       //!< Page 0 receive status registers need reading from chip
     bool volatile pg1rd_;       //!< Page 1 (DIR CS&U data) needs reading from the chip
+    bool subrd_;                //!< Page 0 subcode and burst preamble registers need reading
+    uint8_t nonPcm_;            //!< Non-PCM detection status when the subcode was last read
+    bool volatile ratrd_;       //!< Page 0 SRC ratio readback needs reading, at low priority
+    uint8_t ratioSeq_;          //!< Incremented with each ratio readback
+    uint16_t ratio_;            //!< Most recent ratio readback
+    uint32_t period_;           //!< Learned block period in 1/16 FTM0 ticks, 0 while unknown
+    uint16_t lastBlock_;        //!< Timestamp of the previous block start
+    bool havePrev_;             //!< lastBlock_ is valid
     int16_t delta_;             //!< Timestamp difference relative to BLS pulse
+    uint16_t capt_;             //!< Timestamp of the block being read
+    uint16_t evCapt_;           //!< Timestamp of the last interrupt
+    int16_t evDelta_;           //!< Timestamp difference of the last interrupt
     Integration const &in_;     //!< Channel integration data
     lpc865::SpiQueue &spiq_;    //!< SPI port driver to use for controlling the channel
     lpc865::Ftm &ftm_;          //!< Timer responsible for phase management
     lpc865::Pint &pint_;        //!< Pin interrupt driver
+    Resume resume_;             //!< Completion handler for src_
     src4392::Src4392 src_;      //!< SRC4392 register set cache
 };
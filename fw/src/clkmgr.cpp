@@ -5,20 +5,19 @@
  * @{
  */
 module;
+#include <algorithm>
 #include <cstdint>
 #include "externs.h"
-#include "coroutine.hpp"
 module clkmgr;
+import src4392_drv;
 
 
 void Clkmgr::act() {
-    CORO_REENTER(coro_) {
-        CORO_YIELD channels_[0].handleTxBlock();
-        CORO_YIELD channels_[1].handleTxBlock();
-        CORO_YIELD channels_[2].handleTxBlock();
-        CORO_YIELD channels_[3].handleTxBlock();
-        pint_.enable(irq_, 1);
-    }
+    // The channels queue their own SPI sequences, so there is no need to
+    // wait for one before notifying the next.
+    for (unsigned n = 0; n < Channel::maxChannels; ++n)
+        channels_[n].handleTxBlock();
+    pint_.enable(irq_, 1);
 }
 
 void Clkmgr::isr() {
@@ -27,7 +26,8 @@ void Clkmgr::isr() {
 }
 
 Clkmgr::Clkmgr(lpc865::Pint &pint, Channel *channels, uint8_t irq)
-    : irq_{irq}
+    : Handler{readySet}
+    , irq_{irq}
     , pint_{pint}
     , channels_{channels}
 {
@@ -36,13 +36,69 @@ Clkmgr::Clkmgr(lpc865::Pint &pint, Channel *channels, uint8_t irq)
 
 
 void ChannelManagement::act() {
+    if (busy_)
+        return;
+    busy_ = true;
     print("%");
-    CORO_REENTER(coro_) {
-        CORO_YIELD channels_[0].updateSrcCtrl();
-        CORO_YIELD channels_[1].updateSrcCtrl();
-        CORO_YIELD channels_[2].updateSrcCtrl();
-        CORO_YIELD channels_[3].updateSrcCtrl();
+    out_.start = wheel_.now();
+    std::ranges::fill(out_.configured, waiting);
+    std::ranges::fill(out_.firstBlock, waiting);
+    // The shared table is the one of the first channel. Channels with a
+    // table of their own are only set to page 0 by the broadcast. On a
+    // repeat, all are, as the table would revert what the host has set.
+    auto base = channels_[0].integration().base;
+    uint8_t all = 0;
+    shared_ = 0;
+    for (unsigned n = 0; n < Channel::maxChannels; ++n) {
+        auto const &in = channels_[n].integration();
+        all |= 1u << in.in.addr;
+        if (!repeat_ && in.base.data() == base.data() && in.base.size() == base.size())
+            shared_ |= 1u << in.in.addr;
+        // Batches queued from now on follow the broadcast
+        channels_[n].resetPage();
+    }
+    repeat_ = true;
+    src4392::Src4392::broadcast(spiq_, entries_, base, all, shared_, &broadcast_);
+}
+
+/** Write the rest once the broadcast has completed, and start measuring. */
+void ChannelManagement::configure() {
+    for (unsigned n = 0; n < Channel::maxChannels; ++n)
+        channels_[n].initSrc(!(shared_ & (1u << channels_[n].integration().in.addr)));
+    wheel_.arm(timer_, 1);
+}
+
+void ChannelManagement::poll() {
+    uint32_t elapsed = wheel_.now() - out_.start;
+    bool done = true;
+    for (unsigned n = 0; n < Channel::maxChannels; ++n) {
+        if (out_.configured[n] == waiting && channels_[n].configured())
+            out_.configured[n] = uint16_t(elapsed);
+        if (out_.firstBlock[n] == waiting && channels_[n].receiving())
+            out_.firstBlock[n] = uint16_t(elapsed);
+        done = done && out_.firstBlock[n] != waiting;
+    }
+    // Channels without an input never deliver a block, so give up before
+    // the times would become ambiguous.
+    if (done || elapsed >= waiting - 1) {
+        wheel_.cancel(timer_);
+        busy_ = false;
     }
 }
 
+ChannelManagement::ChannelManagement(Channel *channels, lpc865::SpiQueue &spiq, TimerWheel &wheel)
+    : channels_{channels}
+    , spiq_{spiq}
+    , wheel_{wheel}
+    , broadcast_{*this}
+    , pollHdl_{*this}
+    , timer_{pollHdl_, 1}
+    , entries_{}
+    , shared_{0}
+    , busy_{false}
+    , repeat_{false}
+    , out_{}
+{
+}
+
 /** @}*/
@@ -7,12 +7,16 @@
  */
 
 module;
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include "coroutine.hpp"
+#include <span>
 export module clkmgr;
 import handler;
 import nvic_drv;
 import pint_drv;
+import spi_queue;
+import timer;
 import channel;
 
 /** Clock Manager.
@@ -58,24 +62,80 @@ public:
     Clkmgr(lpc865::Pint &pint, Channel *channels, uint8_t irq);
 
 private:
-    Coroutine<int8_t> coro_;
     uint8_t irq_;
     lpc865::Pint &pint_;
     Channel *channels_;
 };
 
 
+/** Bring-up of the SRC4392 chips.
+ *
+ * The shared part of the initial register values is written to all chips that
+ * use it with a single broadcast transfer, straight from flash. Then each chip
+ * gets its overrides written, or all of page 0 if it doesn't share the table.
+ * The chips are thus configured in parallel, instead of one after another.
+ *
+ * The time until each chip is configured, and until it delivers its first
+ * block with the receiver locked, is measured in timer ticks, by polling the
+ * channels once per tick. It is measured from the start of the bring-up, which
+ * is right after reset for the first one. A bring-up can be repeated at any
+ * time by posting the handler, for instance to recover a chip after a
+ * hot-swap; a post during a bring-up is ignored. A repeat keeps the
+ * configuration the host has set: the broadcast only sets the page, and each
+ * chip then gets all of page 0 written from its register cache.
+ */
 export class ChannelManagement : public Handler {
 public:
-    explicit ChannelManagement(Channel *channels)
-        : channels_{channels}
-    {}
+    /** Bring-up times. */
+    struct BringUp {
+        uint32_t start;                             //!< Tick when the last bring-up started
+        uint16_t configured[Channel::maxChannels];  //!< Ticks until the registers were written, 0xFFFF while waiting
+        uint16_t firstBlock[Channel::maxChannels];  //!< Ticks until the first locked block, 0xFFFF while waiting
+    };
+
+    static constexpr uint16_t waiting = 0xFFFF;
+
+    /** Get the bring-up times, for exposing them to the host. */
+    std::span<std::byte> bringUp() {
+        return std::as_writable_bytes(std::span(&out_, 1));
+    }
 
+    /** Starts a bring-up, unless one is running already. */
     void act() override;
 
+    ChannelManagement(Channel *channels, lpc865::SpiQueue &spiq, TimerWheel &wheel);
+
 private:
-    Coroutine<int8_t> coro_;
+    /** Completion handler of the broadcast. It is called synchronously
+     * by the SPI queue, and never posted.
+     */
+    struct Broadcast : Handler {
+        explicit Broadcast(ChannelManagement &mgmt) : mgmt_{mgmt} {}
+        void act() override { mgmt_.configure(); }
+        ChannelManagement &mgmt_;
+    };
+
+    /** Posted by the timer on each tick during the bring-up. */
+    struct Poll : Handler {
+        explicit Poll(ChannelManagement &mgmt) : mgmt_{mgmt} {}
+        void act() override { mgmt_.poll(); }
+        ChannelManagement &mgmt_;
+    };
+
+    void configure();
+    void poll();
+
     Channel *channels_;
+    lpc865::SpiQueue &spiq_;
+    TimerWheel &wheel_;
+    Broadcast broadcast_;
+    Poll pollHdl_;
+    Timer timer_;
+    std::array<lpc865::SpiQueue::Entry, 2> entries_;    //!< Entries of the broadcast
+    uint8_t shared_;            //!< Chip selects that got the shared table
+    bool busy_;                 //!< A bring-up is running
+    bool repeat_;               //!< The caches hold the configuration from an earlier bring-up
+    BringUp out_;
 };
 
 
@@ -0,0 +1,206 @@
+/** @file
+ * Persistent configuration in on-chip flash.
+ * @addtogroup AES42HAT_ctrl
+ * @ingroup AES42HAT
+ * @{
+ */
+module;
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+module config_store;
+import nvic_drv;
+
+// Config store region, defined by the linker script
+extern "C" std::byte __config_start[];
+extern "C" std::byte __config_end[];
+
+// IAP entry point in the boot ROM, and the commands used
+using IapEntry = void (*)(uint32_t *cmd, uint32_t *result);
+static IapEntry const iapEntry = reinterpret_cast<IapEntry>(0x0F001FF1);
+static constexpr uint32_t iapPrepare = 50;
+static constexpr uint32_t iapCopy = 51;
+static constexpr uint32_t iapErase = 52;
+static constexpr uint32_t iapSuccess = 0;
+
+/** Call an IAP command.
+ * The flash can't be read while the command runs, so neither may the
+ * interrupt vectors and service routines.
+ */
+static uint32_t iap(uint32_t cmd0, uint32_t p1, uint32_t p2, uint32_t p3 = 0, uint32_t p4 = 0) {
+    uint32_t cmd[5] = { cmd0, p1, p2, p3, p4 };
+    uint32_t result[5] = {};
+    arm::disable_irq();
+    iapEntry(cmd, result);
+    arm::enable_irq();
+    return result[0];
+}
+
+/** Continue a CRC-16/CCITT calculation. */
+static uint16_t crc16(std::byte const *data, size_t size, uint16_t crc) {
+    while (size--) {
+        crc ^= uint16_t(*data++) << 8;
+        for (unsigned i = 0; i < 8; ++i)
+            crc = crc & 0x8000 ? uint16_t(crc << 1 ^ 0x1021) : uint16_t(crc << 1);
+    }
+    return crc;
+}
+
+/** Size of a record in flash, with the header, CRC and padding. */
+static constexpr uint32_t recordSize(uint32_t payload) {
+    uint32_t size = 8 + payload + 2;
+    return (size + ConfigStore::pageSize - 1) / ConfigStore::pageSize * ConfigStore::pageSize;
+}
+
+/** Check the CRC of a record, given its header. */
+static bool valid(std::byte const *rec, uint16_t size) {
+    uint16_t crc = crc16(rec, 8 + size, 0xFFFF);
+    return uint8_t(rec[8 + size]) == uint8_t(crc) && uint8_t(rec[8 + size + 1]) == uint8_t(crc >> 8);
+}
+
+/** Collects a record in a page buffer, and programs each page when full. */
+class PageWriter {
+public:
+    PageWriter(ConfigStore &store, uint32_t addr, bool (ConfigStore::*program)(uint32_t, std::byte const *))
+        : store_{store}, program_{program}, addr_{addr}, fill_{0}, ok_{true} {}
+
+    void put(std::byte const *data, size_t size) {
+        while (size > 0 && ok_) {
+            size_t n = std::min<size_t>(size, ConfigStore::pageSize - fill_);
+            std::memcpy(page_ + fill_, data, n);
+            fill_ += n;
+            data += n;
+            size -= n;
+            if (fill_ == ConfigStore::pageSize)
+                flush();
+        }
+    }
+
+    /** Pad the last page with the erased value, and program it. */
+    bool finish() {
+        if (fill_ > 0 && ok_) {
+            std::fill(page_ + fill_, page_ + ConfigStore::pageSize, std::byte{0xFF});
+            flush();
+        }
+        return ok_;
+    }
+
+private:
+    void flush() {
+        ok_ = (store_.*program_)(addr_, page_);
+        addr_ += ConfigStore::pageSize;
+        fill_ = 0;
+    }
+
+    ConfigStore &store_;
+    bool (ConfigStore::*program_)(uint32_t, std::byte const *);
+    uint32_t addr_;
+    uint32_t fill_;
+    bool ok_;
+    alignas(4) std::byte page_[ConfigStore::pageSize];  // the IAP copies from word aligned RAM
+};
+
+std::byte const *ConfigStore::bankStart(unsigned bank) const {
+    return __config_start + bank * bankSize_;
+}
+
+void ConfigStore::scan() {
+    uint32_t best = 0;
+    latest_ = {};
+    bank_ = 0;
+    for (unsigned b = 0; b < banks; ++b) {
+        auto *start = bankStart(b);
+        uint32_t off = 0;
+        while (off + sizeof(Header) <= bankSize_) {
+            Header h;
+            std::memcpy(&h, start + off, sizeof h);
+            uint32_t len = recordSize(h.size);
+            if (h.magic != magic || off + len > bankSize_)
+                break;
+            if (valid(start + off, h.size) && (latest_.empty() || int32_t(h.seq - best) > 0)) {
+                best = h.seq;
+                bank_ = b;
+                latest_ = std::span(start + off + sizeof h, h.size);
+            }
+            off += len;
+        }
+        end_[b] = off;
+    }
+    stats_.seq = latest_.empty() ? 0 : best;
+    stats_.size = uint16_t(latest_.size());
+}
+
+bool ConfigStore::erase(unsigned bank) {
+    uint32_t first = uint32_t(reinterpret_cast<uintptr_t>(bankStart(bank))) / sectorSize;
+    uint32_t last = first + bankSize_ / sectorSize - 1;
+    ++stats_.erases;
+    return iap(iapPrepare, first, last) == iapSuccess
+        && iap(iapErase, first, last, cclk_) == iapSuccess;
+}
+
+bool ConfigStore::program(uint32_t addr, std::byte const *page) {
+    uint32_t sector = addr / sectorSize;
+    return iap(iapPrepare, sector, sector) == iapSuccess
+        && iap(iapCopy, addr, uint32_t(reinterpret_cast<uintptr_t>(page)), pageSize, cclk_) == iapSuccess;
+}
+
+bool ConfigStore::save(std::span<std::span<std::byte const> const> parts) {
+    size_t size = 0;
+    for (auto p : parts)
+        size += p.size();
+    uint32_t len = recordSize(size);
+    if (len > bankSize_ || size > UINT16_MAX) {
+        ++stats_.failures;
+        return false;
+    }
+
+    // Append to the current bank if the pages behind its last record are
+    // still erased, or start over in the other bank.
+    unsigned b = bank_;
+    auto *pos = bankStart(b) + end_[b];
+    if (end_[b] + len > bankSize_ || !std::all_of(pos, pos + len, [](std::byte v) { return v == std::byte{0xFF}; })) {
+        b ^= 1;
+        end_[b] = 0;
+        if (!erase(b)) {
+            ++stats_.failures;
+            return false;
+        }
+    }
+
+    auto addr = uint32_t(reinterpret_cast<uintptr_t>(bankStart(b))) + end_[b];
+    Header h{ .magic = magic, .size = uint16_t(size), .seq = stats_.seq + 1 };
+    auto *hb = reinterpret_cast<std::byte const *>(&h);
+    uint16_t crc = crc16(hb, sizeof h, 0xFFFF);
+    PageWriter w{ *this, addr, &ConfigStore::program };
+    w.put(hb, sizeof h);
+    for (auto p : parts) {
+        w.put(p.data(), p.size());
+        crc = crc16(p.data(), p.size(), crc);
+    }
+    std::byte tail[2] = { std::byte(crc), std::byte(crc >> 8) };
+    w.put(tail, sizeof tail);
+    bool ok = w.finish();
+
+    scan();
+    ok = ok && stats_.seq == h.seq;
+    if (ok)
+        ++stats_.saves;
+    else
+        ++stats_.failures;
+    return ok;
+}
+
+ConfigStore::ConfigStore(uint32_t cclk)
+    : cclk_{cclk}
+    , bankSize_{uint32_t(__config_end - __config_start) / banks / sectorSize * sectorSize}
+    , end_{}
+    , bank_{0}
+    , latest_{}
+    , stats_{}
+{
+    scan();
+}
+
+/** @}*/
@@ -0,0 +1,96 @@
+/** @file
+ * Persistent configuration in on-chip flash.
+ *
+ * @addtogroup AES42HAT_ctrl
+ * @ingroup AES42HAT
+ * @{
+ */
+
+module;
+#include <cstddef>
+#include <cstdint>
+#include <span>
+export module config_store;
+
+/** Log-structured store for a configuration snapshot.
+ *
+ * The store occupies the region reserved by the linker script, which is split
+ * into two banks of whole sectors. A snapshot is written as a record, which is
+ * appended behind the previous one in the same bank, so that a sector is only
+ * erased when a bank is full. The next record then goes to the start of the
+ * other bank, which is erased first. The bank with the latest record stays
+ * intact until a newer one has been written completely, so a reset during a
+ * save falls back to the previous snapshot.
+ *
+ * Each record consists of a header with a sequence number and the payload
+ * size, the payload, and a CRC over both, padded to whole flash pages. The
+ * valid record with the highest sequence number is the current one. Records
+ * with a wrong CRC, like one cut short by a reset, are skipped.
+ *
+ * Erasing and programming go through the IAP functions of the boot ROM. The
+ * flash can't be read meanwhile, so the interrupts are disabled for each
+ * operation, i.e. for a few milliseconds at a time.
+ */
+export class ConfigStore {
+public:
+    static constexpr uint32_t pageSize = 64;        //!< Programming unit of the flash
+    static constexpr uint32_t sectorSize = 1024;    //!< Erase unit of the flash
+
+    /** Store statistics. */
+    struct Stats {
+        uint32_t seq;           //!< Sequence number of the current record, 0 if there is none
+        uint16_t size;          //!< Payload size of the current record
+        uint16_t saves;         //!< Records written since reset
+        uint16_t failures;      //!< Saves that failed since reset
+        uint16_t erases;        //!< Banks erased since reset
+    };
+
+    /** Get the payload of the current record.
+     * @return The payload in flash, or an empty span if there is none
+     */
+    std::span<std::byte const> latest() const { return latest_; }
+
+    /** Write a new record.
+     * @param parts The parts of the payload, in order
+     * @return True if the record has been written and verified
+     *
+     * This takes several milliseconds with interrupts disabled for most of
+     * the time, and must not be called from interrupt context.
+     */
+    bool save(std::span<std::span<std::byte const> const> parts);
+
+    /** Get the statistics, for exposing them to the host. */
+    std::span<std::byte> stats() {
+        return std::as_writable_bytes(std::span(&stats_, 1));
+    }
+
+    /** Find the current record.
+     * @param cclk CPU clock in kHz, for timing the flash operations
+     */
+    explicit ConfigStore(uint32_t cclk);
+
+private:
+    /** Header of a record, at the start of a flash page. */
+    struct Header {
+        uint16_t magic;
+        uint16_t size;          //!< Payload size
+        uint32_t seq;           //!< Sequence number, incremented with each record
+    };
+
+    static constexpr uint16_t magic = 0xC0F1;
+    static constexpr unsigned banks = 2;
+
+    void scan();
+    bool erase(unsigned bank);
+    bool program(uint32_t addr, std::byte const *page);
+    std::byte const *bankStart(unsigned bank) const;
+
+    uint32_t cclk_;
+    uint32_t bankSize_;
+    uint32_t end_[banks];       //!< Offset of the first unused page in each bank
+    uint8_t bank_;              //!< Bank holding the current record
+    std::span<std::byte const> latest_;
+    Stats stats_;
+};
+
+//!@}
@@ -9,7 +9,9 @@ module;
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include "ramfunc.h"
 module dma_drv;
+import nvic_drv;
 import SmartDMA;
 
 using namespace lpc865::SmartDMA;
@@ -18,50 +20,109 @@ bool lpc865::Dma::setup(Per per, uintptr_t addr, Handler *hdl) {
     if (per.chan > in_.max_channel)
         return false;
     auto &desc = par_.descs[per.chan];
-    desc.xfer = std::bit_cast<uint32_t>(per);
+    auto &slot = par_.slots[per.chan];
+    slot.per = per;
+    slot.hdl = hdl;
+    slot.flags = 0;
     if (per.dest)
         desc.dst = addr;
     else
         desc.src = addr;
-    desc.link = uintptr_t(hdl);
     return true;
 }
 
-bool lpc865::Dma::start(Mem mem, void *buf, size_t size) {
-    if (mem.chan > in_.max_channel || !buf || size == 0)
-        return false;
-    auto &hw = *in_.registers;
-    auto &desc = par_.descs[mem.chan];
-    auto &chan = hw.CHANNEL[mem.chan];
-    auto per = std::bit_cast<Per>(desc.xfer);
+/** Compute the transfer configuration word of a descriptor. */
+uint32_t lpc865::Dma::xfercfg(Per per, Mem mem, size_t size, bool reload, bool intA, bool intB) {
+    return std::bit_cast<uint32_t>(CHANNEL_XFERCFG{
+        .CFGVALID=1, .RELOAD=reload, .SWTRIG=!per.hwtrig, .CLRTRIG=!reload, .SETINTA=intA, .SETINTB=intB,
+        .WIDTH=per.width, .SRCINC=per.dest?mem.inc:0u, .DSTINC=per.dest?0u:mem.inc,
+        .XFERCOUNT=uint32_t(size) - 1U
+    });
+}
+
+/** Set the memory end address of a descriptor.
+ * The address is that of the last transfer, as required by the hardware.
+ */
+void lpc865::Dma::endAddresses(Descriptor &desc, Per per, Mem mem, uintptr_t buf, size_t size) {
+    uintptr_t stride = mem.inc ? (1u << per.width) << (mem.inc - 1) : 0;
+    uintptr_t end = buf + (size - 1) * stride;
     if (per.dest)
-        desc.src = reinterpret_cast<uintptr_t>(buf) + size;
+        desc.src = end;
     else
-        desc.dst = reinterpret_cast<uintptr_t>(buf) + size;
-    uint32_t mask = 1u << mem.chan;
+        desc.dst = end;
+}
+
+/** Configure a channel and its interrupt enable, leaving it disabled. */
+void lpc865::Dma::configure(unsigned chan, Mem mem) {
+    auto &hw = *in_.registers;
+    auto per = par_.slots[chan].per;
+    uint32_t mask = 1u << chan;
     hw.ENABLECLR0 = mask;
-    chan.CFG = {
-        .PERIPHREQEN=1, .HWTRIGEN=per.hwtrig, .TRIGPOL=per.trigpol,
+    hw.CHANNEL[chan].CFG = {
+        .PERIPHREQEN=!per.noreq, .HWTRIGEN=per.hwtrig, .TRIGPOL=per.trigpol,
         .TRIGTYPE=per.trigtype, .TRIGBURST=per.trigburst, .BURSTPOWER=mem.burstpower,
         .SRCBURSTWRAP=per.dest?mem.burstwrap:0u, .DSTBURSTWRAP=per.dest?0u:mem.burstwrap,
         .CHPRIORITY=mem.prio
     };
-    chan.XFERCFG = {
-        .CFGVALID=1, .RELOAD=0, .SWTRIG=1, .CLRTRIG=1, .SETINTA=mem.setintA, .SETINTB=mem.setintB,
-        .WIDTH=per.width, .SRCINC=per.dest?mem.inc:0u, .DSTINC=per.dest?0u:mem.inc,
-        .XFERCOUNT=uint32_t(size << per.width) - 1U
-    };
     if (mem.setintA || mem.setintB)
         hw.INTENSET0 = mask;
     else
         hw.INTENCLR0 = mask;
     hw.INTA0 = mask;
     hw.INTB0 = mask;
+    par_.slots[chan].flags = 0;
+}
+
+bool lpc865::Dma::start(Mem mem, void *buf, size_t size) {
+    if (mem.chan > in_.max_channel || !buf || size == 0)
+        return false;
+    auto &hw = *in_.registers;
+    auto &desc = par_.descs[mem.chan];
+    auto per = par_.slots[mem.chan].per;
+    endAddresses(desc, per, mem, reinterpret_cast<uintptr_t>(buf), size);
+    configure(mem.chan, mem);
+    hw.CHANNEL[mem.chan].XFERCFG.set(xfercfg(per, mem, size, false, mem.setintA, mem.setintB));
+    uint32_t mask = 1u << mem.chan;
+    hw.SETVALID0 = mask;
+    hw.ENABLESET0 = mask;
+    return true;
+}
+
+bool lpc865::Dma::startRing(Mem mem, void *buf, size_t size, Descriptor &link) {
+    if (mem.chan > in_.max_channel || !buf || size < 2 || size % 2 != 0)
+        return false;
+    assert(reinterpret_cast<uintptr_t>(&link) % 16 == 0);
+    auto &hw = *in_.registers;
+    auto &desc = par_.descs[mem.chan];
+    auto per = par_.slots[mem.chan].per;
+    size_t half = size / 2;
+    auto first = reinterpret_cast<uintptr_t>(buf);
+    endAddresses(desc, per, mem, first, half);
+    link = desc;
+    endAddresses(link, per, mem, first, size);      // the second half ends with the buffer
+    // Both descriptors reload the other one, the channel descriptor is reloaded
+    // from its entry in the descriptor table.
+    desc.xfer = xfercfg(per, mem, half, true, mem.setintA, false);
+    desc.link = reinterpret_cast<uintptr_t>(&link);
+    link.xfer = xfercfg(per, mem, half, true, false, mem.setintB);
+    link.link = reinterpret_cast<uintptr_t>(&desc);
+    configure(mem.chan, mem);
+    hw.CHANNEL[mem.chan].XFERCFG.set(desc.xfer);
+    uint32_t mask = 1u << mem.chan;
     hw.SETVALID0 = mask;
     hw.ENABLESET0 = mask;
     return true;
 }
 
+uint8_t lpc865::Dma::takeFlags(unsigned chan) {
+    auto &slot = par_.slots[chan];
+    arm::disable_irq();
+    uint8_t flags = slot.flags;
+    slot.flags = 0;
+    arm::enable_irq();
+    return flags;
+}
+
 lpc865::Dma::~Dma() {
     auto &hw = *in_.registers;
     hw.CTRL.set(0);     // disable
@@ -79,28 +140,24 @@ lpc865::Dma::Dma(Intgr const &in, Parameters const &par)
     assert(srambase % 512 == 0);
     hw.SRAMBASE.set(srambase);
     hw.CTRL = CTRL{ .ENABLE=1 };
+    bind(in_.exDMA);
 }
 
-void lpc865::Dma::isr() {
+RAMFUNC void lpc865::Dma::isr() {
     auto &hw = *in_.registers;
-    auto *descs = par_.descs;
+    auto *slots = par_.slots;
     auto inta = hw.INTA0.get().IA;
     hw.INTA0 = inta;
-    while (inta) {
-        auto ch = std::countr_zero(inta);
-        uint32_t mask = 1u << ch;
-        inta &= ~mask;
-        if (auto hdl = reinterpret_cast<Handler*>(descs[ch].link))
-            hdl->post();
-    }
     auto intb = hw.INTB0.get().IB;
     hw.INTB0 = intb;
-    while (intb) {
-        auto ch = std::countr_zero(intb);
+    for (auto pending = inta | intb; pending; ) {
+        auto ch = std::countr_zero(pending);
         uint32_t mask = 1u << ch;
-        intb &= ~mask;
-        if (auto hdl = reinterpret_cast<Handler*>(descs[ch].link))
-            hdl->post();
+        pending &= ~mask;
+        auto &slot = slots[ch];
+        slot.flags = slot.flags | (inta & mask ? 1 : 0) | (intb & mask ? 2 : 0);
+        if (slot.hdl)
+            slot.hdl->post();
     }
 }
 
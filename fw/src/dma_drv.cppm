@@ -28,6 +28,7 @@ public:
         uint32_t trigpol:1;     //!< Hardware trigger is active high
         uint32_t trigtype:1;    //!< Hardware trigger is level triggered
         uint32_t trigburst:1;   //!< Hardware trigger causes a burst transfer
+        uint32_t noreq:1;       //!< Peripheral has no DMA request, transfers are paced by the hardware trigger alone
     };
 
     /** DMA channel settings pertaining to the memory buffer served. */
@@ -48,8 +49,16 @@ public:
         uint32_t link;          //!< Link to next descriptor. If used, this address must be aligned to a multiple of 16 bytes (i.e., the size of a descriptor).
     };
 
+    /** Driver state of a channel. */
+    struct Slot {
+        Per per;                //!< Peripheral settings from setup()
+        Handler *hdl;           //!< Handler to post on interrupt
+        uint8_t volatile flags; //!< Interrupt flags A (bit 0) and B (bit 1) seen since takeFlags()
+    };
+
     struct Parameters {
         Descriptor *descs;      //!< Pointer to array of descriptors
+        Slot *slots;            //!< Pointer to array of channel slots, one per descriptor
     };
 
     /** Set up a peripheral transfer on the given channel.
@@ -67,18 +76,42 @@ public:
      * The transfer details are given in the descriptor chain pointed to by parameter desc.
      * The transfer starts immediately, controlled by the selected handshaking method.
      * Note that the DMA request multiplexing must have been set up before.
-     * @param per peripheral transfer properties
-     * @param addr The peripheral's data register address.
+     * @param mem memory transfer properties
+     * @param buf The memory buffer
+     * @param size The number of transfers
      * @return true if channel is ready to use. false if channel is unavailable or configuration is wrong.
      */
     bool start(Mem mem, void *buf, size_t size);
 
+    /** Start a circular transfer on the given channel.
+     * The buffer is split into two halves, which are transferred alternately
+     * without end. The first half sets interrupt flag A when done, the second
+     * half sets flag B, if enabled in parameter mem. The handler passed to
+     * setup() is posted, and takeFlags() tells which halves are done.
+     * @param mem memory transfer properties
+     * @param buf The memory buffer
+     * @param size The number of transfers, must be even
+     * @param link Descriptor for the second half, must be aligned to 16 bytes
+     * @return true if channel is ready to use. false if channel is unavailable or configuration is wrong.
+     */
+    bool startRing(Mem mem, void *buf, size_t size, Descriptor &link);
+
+    /** Fetch and clear the interrupt flags of a channel.
+     * @param chan Channel number
+     * @return Bit 0 set if flag A was set, bit 1 if flag B was set
+     */
+    uint8_t takeFlags(unsigned chan);
+
     ~Dma();
     Dma(SmartDMA::Intgr const &in, Parameters const &par);
 
     void isr() override;
 
 private:
+    void configure(unsigned chan, Mem mem);
+    uint32_t xfercfg(Per per, Mem mem, size_t size, bool reload, bool intA, bool intB);
+    void endAddresses(Descriptor &desc, Per per, Mem mem, uintptr_t buf, size_t size);
+
     SmartDMA::Intgr const &in_;     //!< Integration parameters
     Parameters const &par_;
 };
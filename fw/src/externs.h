@@ -7,3 +7,4 @@
 
 extern void setActivityLED(bool act);
 extern void print(std::string_view);
+extern void setRequestLine(bool active);
@@ -7,8 +7,10 @@
 module;
 #include <bit>
 #include <cstdint>
+#include <utility>
 module ftm_drv;
 import hwreg;
+import nvic_drv;
 import FTM;
 
 #define FIELDMASK(t, f) []() constexpr { t r{}; r.f -= 1; return std::bit_cast<hwreg::HwReg<t>::Native>(r); }()
@@ -25,11 +27,36 @@ void lpc865::Ftm::setMatch(unsigned ch, uint16_t value) {
     hw.C[ch].V = { .VAL = value };
 }
 
+bool lpc865::Ftm::armMatch(unsigned ch, uint16_t value, Handler &hdl) {
+    auto &hw = *in_.registers;
+    arm::disable_irq();
+    match_[ch] = &hdl;
+    hw.C[ch].V = { .VAL = value };
+    auto csc = hw.C[ch].SC.get();
+    csc.CHF = 0;
+    csc.CHIE = 1;
+    hw.C[ch].SC = csc;
+    // A match before the flag was cleared is lost, so the counter must not
+    // have reached the value without setting the flag anew.
+    bool missed = int16_t(getCount() - value) >= 0 && !hw.C[ch].SC.get().CHF;
+    if (missed) {
+        csc.CHIE = 0;
+        hw.C[ch].SC = csc;
+        match_[ch] = nullptr;
+    }
+    arm::enable_irq();
+    return !missed;
+}
+
 uint16_t lpc865::Ftm::getCapture(unsigned ch) {
     auto &hw = *in_.registers;
     return hw.C[ch].V.get().VAL;
 }
 
+uintptr_t lpc865::Ftm::captureAddress(unsigned ch) const {
+    return reinterpret_cast<uintptr_t>(&in_.registers->C[ch].V);
+}
+
 void lpc865::Ftm::setHandlers(Handler *overflow, Handler *reload) {
     auto &hw = *in_.registers;
     overflow_ = overflow;
@@ -50,6 +77,7 @@ lpc865::Ftm::Ftm(Intgr const &in, Parameters const &par)
     , in_{in}
     , overflow_{nullptr}
     , reload_{nullptr}
+    , match_{}
 {
     static constexpr C_SC cscTbl[] = {
         { .ELSA = 0, .ELSB = 0, .MSA = 0, .MSB = 0 },   // off
@@ -60,6 +88,7 @@ lpc865::Ftm::Ftm(Intgr const &in, Parameters const &par)
         { .ELSA = 1, .ELSB = 0, .MSA = 1, .MSB = 0 },   // compareToggle
         { .ELSA = 0, .ELSB = 1, .MSA = 0, .MSB = 1 },   // pwmPos
         { .ELSA = 1, .ELSB = 1, .MSA = 0, .MSB = 1 },   // pwmNeg
+        { .ELSA = 0, .ELSB = 0, .MSA = 1, .MSB = 0 },   // compare
     };
 
     auto &hw = *in_.registers;
@@ -81,12 +110,13 @@ lpc865::Ftm::Ftm(Intgr const &in, Parameters const &par)
         auto ch = par.ch[i];
         auto csc = cscTbl[ch.mode];
         csc.TRIGMODE = ch.trig;
-        csc.CHIE = ch.intr;
+        csc.CHIE = ch.intr || ch.dma;   // the DMA request needs the interrupt enable, too
+        csc.DMA = ch.dma;
         hw.C[i].SC = csc;
         hw.C[i].V = 0xFFFF;
         oinit |= ch.inv ? oiMask : 0;
         pol |= ch.inv ? polMask : 0;
-        pwmen |= ch.mode >= pwmCombine ? pwmenMask : 0;
+        pwmen |= ch.mode >= pwmCombine && ch.mode != compare ? pwmenMask : 0;
         if ((i & 1) == 0 && ch.mode == pwmCombine) {
             comb |= combineMask;
             comb |= compMask;
@@ -95,6 +125,7 @@ lpc865::Ftm::Ftm(Intgr const &in, Parameters const &par)
     hw.SC = std::bit_cast<uint32_t>(sc) | pwmen;
     hw.OUTINIT = oinit;
     hw.POL = pol;
+    hw.EXTTRIG = EXTTRIG{ .INITTRIGEN = par.inittrig };
     hw.MODE = MODE{ .FTMEN = 1, .INIT=1, .WPDIS=WPDIS_disabled };
     insert(in_.exFTM);
 }
@@ -111,6 +142,17 @@ void lpc865::Ftm::isr() {
         reload_->post();
     }
     hw.SC = sc;
+    for (unsigned i = 0; i <= in_.max_channel; ++i) {
+        if (!match_[i])
+            continue;
+        auto csc = hw.C[i].SC.get();
+        if (!csc.CHF)
+            continue;
+        csc.CHF = 0;
+        csc.CHIE = 0;
+        hw.C[i].SC = csc;
+        std::exchange(match_[i], nullptr)->post();
+    }
 }
 
 /** @}*/
@@ -44,12 +44,26 @@ public:
      */
     void setMatch(unsigned ch, uint16_t value);
 
+    /** Post a handler once, when the counter reaches a value.
+     * @param ch Channel number, of a channel in compare mode
+     * @param value Match value, less than half the counter range ahead
+     * @param hdl Handler to post, in interrupt context
+     * @return false if the counter has passed the value already, in which
+     *         case the handler isn't posted
+     */
+    bool armMatch(unsigned ch, uint16_t value, Handler &hdl);
+
     /** Get the capture value of the given channel.
      * @param ch Channel number
      * @return Last capture value
      */
     uint16_t getCapture(unsigned ch);
 
+    /** Get the address of the capture register of the given channel, as a
+     * DMA source.
+     */
+    uintptr_t captureAddress(unsigned ch) const;
+
     /** Set interrupt handlers.
      * @param overflow Handler for overflow interrupt
      * @param reload Handler for reload interrupt
@@ -77,6 +91,7 @@ public:
         compareToggle,  //!< Channel compare toggles output
         pwmPos,         //!< positive PWM output (rising on overflow, falling on compare)
         pwmNeg,         //!< negative PWM output (falling on overflow, rising on compare)
+        compare,        //!< Channel compare without output, for armMatch()
     };
 
     /** Operating parameters for the FTM. */
@@ -86,14 +101,16 @@ public:
         uint16_t updn:1;    //!< 1: Counter counts up and down (PWM is center-aligned)
         uint16_t ovint:1;   //!< Counter overflow interrupt enable
         uint16_t rlint:1;   //!< Counter reload interrupt enable
+        uint16_t inittrig:1;//!< Counter initialization outputs a trigger pulse, e.g. for the ADC
         uint16_t init;      //!< Counter initial value
         uint16_t mod;       //!< Counter modulus (value where it resets)
         uint16_t hcyc;      //!< Half cycle reload value (= reload opportunity)
         struct Channel {
-            uint8_t mode:3; //!< Channel mode (see enum Mode)
+            uint8_t mode:4; //!< Channel mode (see enum Mode)
             uint8_t inv:1;  //!< Inverted output
             uint8_t trig:1; //!< Channel outputs trigger pulse
             uint8_t intr:1; //!< Channel interrupt enable
+            uint8_t dma:1;  //!< Channel event requests a DMA transfer instead of an interrupt
         } ch[8];
     };
 
@@ -106,6 +123,7 @@ private:
     FTM::Intgr const &in_;
     Handler *overflow_;
     Handler *reload_;
+    Handler *match_[8];     //!< Handlers of the armed matches, per channel
 };
 
 } // namespace
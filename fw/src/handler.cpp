@@ -7,14 +7,93 @@
  */
 
 module;
+#include <algorithm>
+#include <bit>
 #include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
 #include "externs.h"
+#include "ramfunc.h"
 module handler;
 import nvic_drv;
 
 static Handler* anchor = nullptr;
 
-bool Handler::post() {
+/** Flags of the ready set.
+ *
+ * Each registered handler owns one byte, which is set to nonzero when the
+ * handler is posted. The flags are stored as words, so that the dispatcher can
+ * check four of them at once. Byte access to the words is allowed, since it
+ * goes through a character type.
+ */
+static uint32_t volatile ready[Handler::readySlots / 4] = {};
+static Handler *slots[Handler::readySlots] = {};
+static uint8_t slotCount = 0;
+
+static inline uint8_t volatile &readyFlag(unsigned slot) {
+    return reinterpret_cast<uint8_t volatile *>(ready)[slot];
+}
+
+#if HANDLER_PROFILE
+static Handler::Profile profileData = {};
+
+static void clearStats(Handler::Stats &s) {
+    s = Handler::Stats{ .busyMin = UINT32_MAX, .waitMin = UINT32_MAX };
+}
+
+/** Histogram bin of a time value. Bin 0 is below 64 cycles, each further bin
+ * covers a factor of 4, and the last bin takes everything above.
+ */
+static inline unsigned histBin(uint32_t cycles) {
+    int bin = (std::bit_width(cycles) - 5) / 2;
+    return std::clamp(bin, 0, int(Handler::histBins - 1));
+}
+
+std::span<std::byte> Handler::profile() {
+    return std::as_writable_bytes(std::span(&profileData, 1));
+}
+
+void Handler::clearProfile() {
+    profileData.idle = 0;
+    profileData.elapsed = 0;
+    for (auto &s : profileData.stats)
+        clearStats(s);
+}
+#endif
+
+Handler::Handler() {
+#if HANDLER_PROFILE
+    if (profileData.count < profileSlots) {
+        stats_ = &profileData.stats[profileData.count++];
+        clearStats(*stats_);
+    }
+#endif
+}
+
+Handler::Handler(ReadySet)
+    : Handler()
+{
+#if HANDLER_READYSET
+    if (slotCount < readySlots) {
+        slot_ = slotCount;
+        slots[slotCount++] = this;
+    }
+#endif
+}
+
+RAMFUNC bool Handler::post() {
+    if (slot_ != noSlot) {
+        // A single byte store, which can't be torn by an interrupt. A race
+        // with the dispatcher clearing the flag only affects the return value.
+        bool result = !readyFlag(slot_);
+#if HANDLER_PROFILE
+        if (result)
+            posted_ = arm::cycleCount();
+#endif
+        readyFlag(slot_) = 1;
+        return result;
+    }
     bool result = false;
     arm::disable_irq();
     if(!next_) {      // post only if not already posted
@@ -27,6 +106,9 @@ bool Handler::post() {
         }
         anchor = this;  // make anchor point to newest Handler
         result = true;
+#if HANDLER_PROFILE
+        posted_ = arm::cycleCount();
+#endif
     }
     arm::enable_irq();
     return result;
@@ -46,13 +128,54 @@ inline Handler *Handler::unque() {
     return res;
 }
 
-size_t Handler::poll_one() {
-    if (auto *node = unque()) {
+inline Handler *Handler::unready() {
+    for (unsigned i = 0; i < std::size(ready); ++i) {
+        if (uint32_t w = ready[i]) {
+            // little endian: the lowest nonzero byte holds the lowest slot number
+            unsigned slot = i * 4 + std::countr_zero(w) / 8;
+            readyFlag(slot) = 0;    // clear before acting, so a new post isn't lost
+            return slots[slot];
+        }
+    }
+    return nullptr;
+}
+
+#if HANDLER_PROFILE
+/** Call act() of a handler, and record its timing. */
+void Handler::dispatch(Handler *node) {
+    uint32_t start = arm::cycleCount();
+    node->act();
+    uint32_t end = arm::cycleCount();
+    if (auto *s = node->stats_) {
+        uint32_t wait = arm::cycleDiff(node->posted_, start);
+        uint32_t busy = arm::cycleDiff(start, end);
+        ++s->runs;
+        s->busyMin = std::min(s->busyMin, busy);
+        s->busyMax = std::max(s->busyMax, busy);
+        s->busySum += busy;
+        s->waitMin = std::min(s->waitMin, wait);
+        s->waitMax = std::max(s->waitMax, wait);
+        s->waitSum += wait;
+        ++s->busyHist[histBin(busy)];
+        ++s->waitHist[histBin(wait)];
+    }
+}
+#endif
+
+RAMFUNC size_t Handler::poll_one() {
+    auto *node = unready();
+    if (!node) {
+        node = unque();
+        if (!node)
+            return 0;
         node->next_ = nullptr;
-        node->act();
-        return 1;
     }
-    return 0;
+#if HANDLER_PROFILE
+    dispatch(node);
+#else
+    node->act();
+#endif
+    return 1;
 }
 
 size_t Handler::poll() {
@@ -63,9 +186,26 @@ size_t Handler::poll() {
 }
 
 void Handler::run() {
-    while (true)
+#if HANDLER_PROFILE
+    arm::startCycleCounter();
+    uint32_t last = arm::cycleCount();
+#endif
+    while (true) {
         if (poll_one() == 0) {
             setActivityLED(false);
+#if HANDLER_PROFILE
+            // Interrupts taken while waiting are counted as idle time
+            uint32_t sleep = arm::cycleCount();
+            arm::wfe();
+            profileData.idle += arm::cycleDiff(sleep, arm::cycleCount());
+#else
             arm::wfe();
+#endif
         }
+#if HANDLER_PROFILE
+        uint32_t now = arm::cycleCount();
+        profileData.elapsed += arm::cycleDiff(last, now);
+        last = now;
+#endif
+    }
 }
@@ -9,13 +9,83 @@
 module;
 #include <cstddef>
 #include <cstdint>
+#include <span>
 export module handler;
 
+/** Deferred work item.
+ *
+ * A handler gets posted, typically from interrupt context, and its act()
+ * function is called later from the main loop in Handler::run().
+ *
+ * There are two ways a posted handler can be queued:
+ * - The handler ring, which can take any number of handlers, and which keeps
+ *   them in the order of posting. Manipulating the ring requires interrupts to
+ *   be masked briefly, since the Cortex-M0+ has no exclusive load/store.
+ * - The ready set, which has a fixed number of slots, one for each handler
+ *   that was constructed with the `readySet` tag. Such a handler owns a flag
+ *   byte, and posting it is a single byte store, which needs no interrupt
+ *   masking. The dispatcher finds ready handlers by scanning the flags a word
+ *   at a time, so the handlers registered first have the highest priority.
+ *
+ * The ready set is meant for the handlers that get posted from interrupt
+ * service routines. When the build option HANDLER_READYSET is off, or when all
+ * slots are taken, handlers constructed with the tag use the ring instead.
+ *
+ * When the build option HANDLER_PROFILE is on, each handler records how long
+ * it waits between post() and dispatch, and how long its act() takes, in CPU
+ * cycles. The time spent waiting for events in run() is also recorded. The
+ * data is available as a block of memory, see profile(). Without the option,
+ * none of this code or data is present.
+ */
 export class Handler {
     Handler(Handler &&) =delete;
+public:
+    struct ReadySet {};
+    static constexpr ReadySet readySet{};
+    static constexpr size_t readySlots = 16;    //!< Number of slots in the ready set (multiple of 4)
+
+#if HANDLER_PROFILE
+    static constexpr size_t profileSlots = 12;  //!< Number of handlers that can be profiled
+    static constexpr size_t histBins = 8;       //!< Histogram bins, each covering a factor of 4 from 64 cycles
+
+    /** Profiling statistics of one handler.
+     * All times are in CPU cycles. Sums wrap around, so the mean should be
+     * computed from the differences between two readings.
+     */
+    struct Stats {
+        uint32_t runs;              //!< Number of act() calls
+        uint32_t busyMin;           //!< Shortest act() execution time
+        uint32_t busyMax;           //!< Longest act() execution time
+        uint32_t busySum;           //!< Sum of act() execution times
+        uint32_t waitMin;           //!< Shortest wait from post() to dispatch
+        uint32_t waitMax;           //!< Longest wait from post() to dispatch
+        uint32_t waitSum;           //!< Sum of waits from post() to dispatch
+        uint16_t busyHist[histBins];    //!< Histogram of execution times
+        uint16_t waitHist[histBins];    //!< Histogram of waits
+    };
+
+    /** Profiling data of all handlers, in the order of construction. */
+    struct Profile {
+        uint32_t idle;              //!< Cycles spent waiting for events in run()
+        uint32_t elapsed;           //!< Cycles elapsed in run()
+        uint32_t count;             //!< Number of profiled handlers
+        Stats stats[profileSlots];
+    };
+
+    /** The profiling data as a block of memory. */
+    static std::span<std::byte> profile();
+
+    /** Reset all profiling statistics. */
+    static void clearProfile();
+#endif
+
 protected:
     ~Handler() =default;
-    Handler() =default;
+    Handler();
+
+    /** Construct a handler with its own flag in the ready set. */
+    explicit Handler(ReadySet);
+
 public:
     virtual void act() =0;
 
@@ -26,7 +96,17 @@ public:
     static size_t poll_one();
 
 private:
+    static constexpr uint8_t noSlot = 0xFF;
+
     static Handler *unque();
+    static Handler *unready();
 
     Handler *next_ = nullptr;
+    uint8_t slot_ = noSlot;     //!< Index of the ready flag, or noSlot when using the ring
+#if HANDLER_PROFILE
+    static void dispatch(Handler *node);
+
+    uint32_t posted_ = 0;       //!< Cycle count at post()
+    Stats *stats_ = nullptr;    //!< Profiling statistics, or nullptr if out of slots
+#endif
 };
@@ -8,12 +8,13 @@ module;
 #include <bit>
 #include <cstddef>
 #include <cstdint>
+#include "ramfunc.h"
 module i2c_tgt_drv;
 import I2C;
 
 using namespace lpc865::I2C;
 
-void lpc865::I2cTarget::isr() {
+RAMFUNC void lpc865::I2cTarget::isr() {
     auto &hw = *in_.registers;
     auto stat = hw.STAT.get();
     if (stat.SLVDESEL) {
@@ -66,7 +67,7 @@ lpc865::I2cTarget::I2cTarget(Intgr const &in, Parameters const &par)
 {
     // Check if the callback list matches the slave addresses
     size_t n = par.qmode ? par.qual0 - par.addr0 + 1 : 1U << std::popcount(par.qual0);
-    n = (par.dis0 ? 0 : n) + !par.dis1 + !par.dis1 + !par.dis1;
+    n = (par.dis0 ? 0 : n) + !par.dis1 + !par.dis2 + !par.dis3;
     if (par.callbacks.size() != n)
         return;
 
@@ -2,146 +2,83 @@
  * main function for the AES42HAT
  */
 
+import adc_drv;
 import dma_drv;
 import ftm_drv;
+import capture_log;
 import i2c_tgt_drv;
 import pint_drv;
 import spi_queue;
+import src4392_drv;
+import src4392_init;
 import usart_drv;
 import wkt_drv;
+import mrt_drv;
+import timer;
 import spi_drv;
 import handler;
 import clkmgr;
 import channel;
+import ratio_mon;
+import config_store;
+import task;
+import bench;
+import board_ctrl;
+import service_req;
+import nvic_drv;
 import LPC865;
 #include "LPC86x_clocks.hpp"
+#include <algorithm>
+#include <span>
 #include <string_view>
 
 using namespace lpc865;
 
-constexpr std::byte operator""_y(unsigned long long value) {
-    return static_cast<std::byte>(value);
-}
-
-static std::initializer_list<std::byte> const srcInitData0 = {
-    0x3F_y, // Register 01: Power-Down and Reset
-    0x00_y, // Register 02: Global Interrupt Status (Read-Only)
-    0x39_y, // Register 03: Port A Control Register 1
-    0x03_y, // Register 04: Port A Control Register 2
-    0x31_y, // Register 05: Port B Control Register 1
-    0x00_y, // Register 06: Port B Control Register 2
-    0x7D_y, // Register 07: Transmitter Control Register 1
-    0x20_y, // Register 08: Transmitter Control Register 2
-    0x01_y, // Register 09: Transmitter Control Register 3
-    0x00_y, // Register 0A: SRC and DIT Status (Read-Only)
-    0x00_y, // Register 0B: SRC and DIT Interrupt Mask Register
-    0x00_y, // Register 0C: SRC and DIT Interrupt Mode Register
-    0x08_y, // Register 0D: Receiver Control Register 1
-    0x00_y, // Register 0E: Receiver Control Register 2
-    0x22_y, // Register 0F: Receiver PLL1 Configuration Register 1
-    0x00_y, // Register 10: Receiver PLL1 Configuration Register 2
-    0x00_y, // Register 11: Receiver PLL1 Configuration Register 3
-    0x00_y, // Register 12: Non-PCM Audio Detection Status Register (Read-Only)
-    0x00_y, // Register 13: Receiver Status Register 1 (Read-Only)
-    0x00_y, // Register 14: Receiver Status Register 2 (Read-Only)
-    0x00_y, // Register 15: Receiver Status Register 3 (Read-Only)
-    0x01_y, // Register 16: Receiver Interrupt Mask Register 1
-    0x00_y, // Register 17: Receiver Interrupt Mask Register 2
-    0x02_y, // Register 18: Receiver Interrupt Mode Register 1
-    0x00_y, // Register 19: Receiver Interrupt Mode Register 2
-    0x00_y, // Register 1A: Receiver Interrupt Mode Register 3
-    0x01_y, // Register 1B: General-Purpose Output 1 (GPO1) Control Register
-    0x00_y, // Register 1C: General-Purpose Output 2 (GPO2) Control Register
-    0x0E_y, // Register 1D: General-Purpose Output 3 (GPO3) Control Register
-    0x09_y, // Register 1E: General-Purpose Output 4 (GPO4) Control Register
-    0x00_y, // Register 1F: Q-Channel Sub-Code Data Register 1 (Read-Only), Bits[7:0], Control and Address
-    0x00_y, // Register 20: Q-Channel Sub-Code Data Register 2 (Read-Only), Bits[15:8], Track
-    0x00_y, // Register 21: Q-Channel Sub-Code Data Register 3 (Read-Only), Bits[23:16], Index
-    0x00_y, // Register 22: Q-Channel Sub-Code Data Register 4 (Read-Only), Bits[31:24], Minutes
-    0x00_y, // Register 23: Q-Channel Sub-Code Data Register 5 (Read-Only), Bits[39:32], Seconds
-    0x00_y, // Register 24: Q-Channel Sub-Code Data Register 6 (Read-Only), Bits[47:40], Frame
-    0x00_y, // Register 25: Q-Channel Sub-Code Data Register 7 (Read-Only), Bits[55:48], Zero
-    0x00_y, // Register 26: Q-Channel Sub-Code Data Register 8 (Read-Only), Bits[63:56], AMIN
-    0x00_y, // Register 27: Q-Channel Sub-Code Data Register 9 (Read-Only), Bits[71:64], ASEC
-    0x00_y, // Register 28: Q-Channel Sub-Code Data Register 10 (Read-Only), Bits[79:72], AFRAME
-    0x00_y, // Register 29: Burst Preamble PC High-Byte Status Register (Read-Only)
-    0x00_y, // Register 2A: Burst Preamble PC Low-Byte Status Register (Read-Only)
-    0x00_y, // Register 2B: Burst Preamble PD High-Byte Status Register (Read-Only)
-    0x00_y, // Register 2C: Burst Preamble PD Low-Byte Status Register (Read-Only)
-    0x02_y, // Register 2D: SRC Control Register 1
-    0x00_y, // Register 2E: SRC Control Register 2
-    0x00_y, // Register 2F: SRC Control Register 3
-    0x00_y, // Register 30: SRC Control Register 4
-    0x00_y, // Register 31: SRC Control Register 5
-    0x00_y, // Register 32: SRC Ratio Readback Register (Read-Only)
-    0x00_y, // Register 33: SRC Ratio Readback Register (Read-Only)
-};
-
-static std::initializer_list<std::byte> const srcInitData = {
-    0x3F_y, // Register 01: Power-Down and Reset
-    0x00_y, // Register 02: Global Interrupt Status (Read-Only)
-    0x31_y, // Register 03: Port A Control Register 1
-    0x00_y, // Register 04: Port A Control Register 2
-    0x31_y, // Register 05: Port B Control Register 1
-    0x00_y, // Register 06: Port B Control Register 2
-    0x79_y, // Register 07: Transmitter Control Register 1
-    0x20_y, // Register 08: Transmitter Control Register 2
-    0x01_y, // Register 09: Transmitter Control Register 3
-    0x00_y, // Register 0A: SRC and DIT Status (Read-Only)
-    0x00_y, // Register 0B: SRC and DIT Interrupt Mask Register
-    0x00_y, // Register 0C: SRC and DIT Interrupt Mode Register
-    0x08_y, // Register 0D: Receiver Control Register 1
-    0x00_y, // Register 0E: Receiver Control Register 2
-    0x22_y, // Register 0F: Receiver PLL1 Configuration Register 1
-    0x00_y, // Register 10: Receiver PLL1 Configuration Register 2
-    0x00_y, // Register 11: Receiver PLL1 Configuration Register 3
-    0x00_y, // Register 12: Non-PCM Audio Detection Status Register (Read-Only)
-    0x00_y, // Register 13: Receiver Status Register 1 (Read-Only)
-    0x00_y, // Register 14: Receiver Status Register 2 (Read-Only)
-    0x00_y, // Register 15: Receiver Status Register 3 (Read-Only)
-    0x01_y, // Register 16: Receiver Interrupt Mask Register 1
-    0x00_y, // Register 17: Receiver Interrupt Mask Register 2
-    0x02_y, // Register 18: Receiver Interrupt Mode Register 1
-    0x00_y, // Register 19: Receiver Interrupt Mode Register 2
-    0x00_y, // Register 1A: Receiver Interrupt Mode Register 3
-    0x01_y, // Register 1B: General-Purpose Output 1 (GPO1) Control Register
-    0x00_y, // Register 1C: General-Purpose Output 2 (GPO2) Control Register
-    0x0E_y, // Register 1D: General-Purpose Output 3 (GPO3) Control Register
-    0x09_y, // Register 1E: General-Purpose Output 4 (GPO4) Control Register
-    0x00_y, // Register 1F: Q-Channel Sub-Code Data Register 1 (Read-Only), Bits[7:0], Control and Address
-    0x00_y, // Register 20: Q-Channel Sub-Code Data Register 2 (Read-Only), Bits[15:8], Track
-    0x00_y, // Register 21: Q-Channel Sub-Code Data Register 3 (Read-Only), Bits[23:16], Index
-    0x00_y, // Register 22: Q-Channel Sub-Code Data Register 4 (Read-Only), Bits[31:24], Minutes
-    0x00_y, // Register 23: Q-Channel Sub-Code Data Register 5 (Read-Only), Bits[39:32], Seconds
-    0x00_y, // Register 24: Q-Channel Sub-Code Data Register 6 (Read-Only), Bits[47:40], Frame
-    0x00_y, // Register 25: Q-Channel Sub-Code Data Register 7 (Read-Only), Bits[55:48], Zero
-    0x00_y, // Register 26: Q-Channel Sub-Code Data Register 8 (Read-Only), Bits[63:56], AMIN
-    0x00_y, // Register 27: Q-Channel Sub-Code Data Register 9 (Read-Only), Bits[71:64], ASEC
-    0x00_y, // Register 28: Q-Channel Sub-Code Data Register 10 (Read-Only), Bits[79:72], AFRAME
-    0x00_y, // Register 29: Burst Preamble PC High-Byte Status Register (Read-Only)
-    0x00_y, // Register 2A: Burst Preamble PC Low-Byte Status Register (Read-Only)
-    0x00_y, // Register 2B: Burst Preamble PD High-Byte Status Register (Read-Only)
-    0x00_y, // Register 2C: Burst Preamble PD Low-Byte Status Register (Read-Only)
-    0x02_y, // Register 2D: SRC Control Register 1
-    0x00_y, // Register 2E: SRC Control Register 2
-    0x00_y, // Register 2F: SRC Control Register 3
-    0x00_y, // Register 30: SRC Control Register 4
-    0x00_y, // Register 31: SRC Control Register 5
-    0x00_y, // Register 32: SRC Ratio Readback Register (Read-Only)
-    0x00_y, // Register 33: SRC Ratio Readback Register (Read-Only)
-};
-
 static lpc865::Ftm::Parameters const ftm0par{ .ps=3, .clks=1, .mod=0xFFFF
     , .ch = {
-        { .mode=::Ftm::capturePos },    // BLS time stamping
-        {},                             // unused    
-        { .mode=::Ftm::captureNeg },    // INTA time stamping
-        { .mode=::Ftm::captureNeg },    // INTB time stamping
-        { .mode=::Ftm::captureNeg },    // INTC time stamping
-        { .mode=::Ftm::captureNeg }     // INTD time stamping
+        { .mode=::Ftm::capturePos, .dma=1 },    // BLS time stamping
+        { .mode=::Ftm::compare },               // Holding status reads for coalescing
+        { .mode=::Ftm::captureNeg, .dma=1 },    // INTA time stamping
+        { .mode=::Ftm::captureNeg, .dma=1 },    // INTB time stamping
+        { .mode=::Ftm::captureNeg, .dma=1 },    // INTC time stamping
+        { .mode=::Ftm::captureNeg, .dma=1 }     // INTD time stamping
+    }
+};
+// Logging of the FTM0 captures. DMA channels 0..4 serve the USARTs, which
+// don't use DMA. See DMA_ITRIG_INMUX in sysinit() for the triggers.
+static CaptureLog::Parameters const p_captures = {
+    .count = 1 + Channel::maxChannels,
+    .ring = {
+        { .ftmch = 0, .dmachan = 0 },   // BLS
+        { .ftmch = 2, .dmachan = 1 },   // INTA
+        { .ftmch = 3, .dmachan = 2 },   // INTB
+#if VARIANT_CHANNELS > 2
+        { .ftmch = 4, .dmachan = 3 },   // INTC
+        { .ftmch = 5, .dmachan = 4 },   // INTD
+#endif
     }
 };
-static lpc865::Ftm::Parameters const ftm1par{ .ps=1, .clks=1, .mod=39999
+
+// SPI clock planning. The function clock of both SPIs is the FRO, see
+// sysinit() and the clock tree setup in main().
+static constexpr uint32_t froHz = 60000000;
+static constexpr Spi::Clocking p_spi = {
+    .fclk = froHz,
+    .maxHz = 30000000,      // half the function clock
+    .readNs = 60,           // twice the SRC4392 output delay plus the input setup time
+    .leadNs = 50,
+    .lagNs = 50,
+    .gapNs = 100,
+};
+
+// SPI bus load of the channels at the planned clocks, see winSpiPlan
+static constexpr Channel::Budget spiPlan = Channel::budget(
+    Spi::plan(p_spi, Spi::speedHz(src4392::Src4392::maxSpeed), true),
+    Spi::plan(p_spi, Spi::speedHz(src4392::Src4392::maxSpeed), false));
+static_assert(spiPlan.rates[5].headroom > 0, "SPI0 too slow for all channels at 192 kHz");
+static Channel::Budget spiBudget = spiPlan;
+
+static lpc865::Ftm::Parameters const ftm1par{ .ps=1, .clks=1, .inittrig=1, .mod=39999
     , .ch = {
         { .mode=::Ftm::pwmNeg, .inv=1 },
         { .mode=::Ftm::pwmNeg, .inv=1 },
@@ -150,17 +87,57 @@ static lpc865::Ftm::Parameters const ftm1par{ .ps=1, .clks=1, .mod=39999
     }
 };
 
-static Channel::Integration const i_channel[] = {
-    { .in={ .addr = 0, .cpm = 0, .src_present=1 }, .irq=0, .tch=2, .rch=0, .init=srcInitData0 },
-    { .in={ .addr = 1, .cpm = 0, .src_present=1 }, .irq=1, .tch=3, .rch=0, .init=srcInitData },
-    { .in={ .addr = 2, .cpm = 0, .src_present=1 }, .irq=2, .tch=4, .rch=0, .init=srcInitData },
-    { .in={ .addr = 3, .cpm = 0, .src_present=1 }, .irq=3, .tch=5, .rch=0, .init=srcInitData }
+// Only the channels fitted in the board variant get integration values, see
+// variant.cppm. The spinoff with two channels uses the first two chip selects.
+static Channel::Integration const i_channel[Channel::maxChannels] = {
+    { .in={ .addr = 0, .cpm = 0, .src_present=1 }, .irq=0, .tch=2, .rch=0, .mch=1, .base=src4392::initBase, .overrides=src4392::initChannelA },
+    { .in={ .addr = 1, .cpm = 0, .src_present=1 }, .irq=1, .tch=3, .rch=0, .mch=1, .base=src4392::initBase },
+#if VARIANT_CHANNELS > 2
+    { .in={ .addr = 2, .cpm = 0, .src_present=1 }, .irq=2, .tch=4, .rch=0, .mch=1, .base=src4392::initBase },
+    { .in={ .addr = 3, .cpm = 0, .src_present=1 }, .irq=3, .tch=5, .rch=0, .mch=1, .base=src4392::initBase }
+#endif
 };
 
 alignas(512) static std::array<Dma::Descriptor, i_DMA0.max_channel+1> dma_descs;
+static std::array<Dma::Slot, i_DMA0.max_channel+1> dma_slots;
 
 static lpc865::Dma::Parameters const p_dma = {
-    .descs = dma_descs.data()
+    .descs = dma_descs.data(),
+    .slots = dma_slots.data()
+};
+
+/** Saves the configuration of all channels in flash, on host command. */
+static struct ConfigSave : Handler {
+    ConfigSave() : Handler{readySet} {}
+    void act() override;
+} configSave;
+
+#if VARIANT_AES42
+/** Forwards the phantom voltage faults to the service request status. */
+static struct PhantomAlarm : Handler {
+    void act() override;
+} phantomAlarm;
+
+// Phantom voltage monitoring on PVA .. PVD, as far as fitted
+static Adc::Parameters const p_adc = {
+    .inputs = (1u << Channel::maxChannels) - 1, // ADC_0 .. ADC_3
+    .trigger = 4,           // FTM1 initialization trigger, i.e. 750 Hz
+    .clkdiv = 0,            // 30 MHz ADC clock
+    .caldiv = 59,           // 500 kHz for calibration
+    .dmachan = 15,          // triggered by ADC sequence A, see DMA_ITRIG_INMUX in sysinit()
+    .shift = 3,             // time constant of 8 blocks, about 85 ms
+    .fullScale = 18150,     // 3.3 V reference times the PVx divider ratio of 5.5
+    .low = 9500,
+    .high = 12500,
+    .hyst = 200,
+    .notify = &phantomAlarm
+};
+#endif
+
+// SRC ratio telemetry
+static RatioMonitor::Parameters const p_ratio = {
+    .interval = 100,        // 100 ms
+    .window = 50,           // 5 s windows
 };
 
 static clocktree::ClockTree<Clocks> clktree;
@@ -170,28 +147,47 @@ static Usart usart1{ i_USART1 };            // Console mode receive USART (RX on
 static Usart usart2{ i_USART2 };            // Mode 3 remote control USART (TX only)
 static Pint pint{ i_PINT };                 // Pin interrupt driver
 static Ftm ftm0{ i_FTM0, ftm0par };         // Wordclock phase measurements
-static Ftm ftm1{ i_FTM1, ftm1par };         // Mode 2 remote control pulse generation
+static CaptureLog captures{ p_captures, ftm0, dma };  // Logs every FTM0 capture
+static Ftm ftm1{ i_FTM1, ftm1par };         // Mode 2 remote control pulse generation, ADC trigger
+#if VARIANT_AES42
+static Adc adc{ i_ADC0, p_adc, dma };       // Phantom voltage monitoring
+#endif
 static Wkt wkt{ i_WKT, {1, 0} };
-static Spi spi0{ i_SPI0, &dma };            // SRC4392 control communication
+static Mrt mrt{ i_MRT0 };
+static TimerWheel timers{ mrt };            // Software timers with a 1 ms tick
+static Spi spi0{ i_SPI0, &dma, p_spi };     // SRC4392 control communication
 static SpiQueue spique{ spi0 };             // Handler queue for SPI0
-static Spi spi1{ i_SPI1, nullptr };         // Wordclock generation
-static Channel chan[4] = {
-    { i_channel[0], spique, ftm0, pint },
-    { i_channel[1], spique, ftm0, pint },
-    { i_channel[2], spique, ftm0, pint },
-    { i_channel[3], spique, ftm0, pint }
+static Spi spi1{ i_SPI1, nullptr, p_spi };  // Wordclock generation
+static ConfigStore config{ 60000 };        // Saved host configuration, restored by the channels
+static Channel chan[Channel::maxChannels] = {
+    { i_channel[0], spique, ftm0, pint, config.latest() },
+    { i_channel[1], spique, ftm0, pint, config.latest() },
+#if VARIANT_CHANNELS > 2
+    { i_channel[2], spique, ftm0, pint, config.latest() },
+    { i_channel[3], spique, ftm0, pint, config.latest() }
+#endif
 };
 static Clkmgr clkmgr{pint, chan, 4};
+static RatioMonitor ratioMon{ p_ratio, timers, chan };
+static ChannelManagement mgmt{ chan, spique, timers };  // SRC4392 bring-up
+static ServiceRequest svcreq{ 0x75 };       // Service request status
+static BoardControl board{ 0x74, svcreq };  // Board control registers
 
 // Operational parameters for target mode I2C0
 static I2cTarget::Parameters const p_I2C0 = {
     .addr0 = 0x70,
-    .dis1 = 1,
-    .dis2 = 1,
+    .dis1 = 0,
+    .addr1 = 0x74,
+    .dis2 = 0,
+    .addr2 = 0x75,
     .dis3 = 1,
     .qmode = 1,
-    .qual0 = 0x73,
-    .callbacks = { &chan[0], &chan[1], &chan[2], &chan[3] }
+    .qual0 = 0x70 + Channel::maxChannels - 1,
+#if VARIANT_CHANNELS > 2
+    .callbacks = { &chan[0], &chan[1], &chan[2], &chan[3], &board, &svcreq }
+#else
+    .callbacks = { &chan[0], &chan[1], &board, &svcreq }
+#endif
 };
 
 static I2cTarget i2c0{ i_I2C0, p_I2C0 };    // Host communication in target mode
@@ -205,15 +201,78 @@ void setActivityLED(bool act) {
     i_GPIO.registers->B[1].B_[7].set(act);
 }
 
+void setRequestLine(bool active) {
+    i_GPIO.registers->B[0].B_[12].set(!active);     // REQ is active low
+}
+
+void ConfigSave::act() {
+    std::array<std::span<std::byte const>, Channel::configParts * Channel::maxChannels> parts;
+    for (unsigned n = 0; n < Channel::maxChannels; ++n)
+        std::ranges::copy(chan[n].config(), parts.begin() + Channel::configParts * n);
+    config.save(parts);
+}
+
+#if VARIANT_AES42
+void PhantomAlarm::act() {
+    svcreq.update(ServiceRequest::srPhantom, adc.faults());
+}
+#endif
+
 int main() {
     i_GPIO.registers->DIRSET[1].set(1 << 7);
+    setRequestLine(false);
+    i_GPIO.registers->DIRSET[0].set(1 << 12);
 
-    clktree.register_fields[1].set(static_cast<Clocks*>(&clktree), 60000000);
+    // The block start interrupts sample the FTM0 captures, so they must not
+    // wait behind the byte-wise I2C service routine. The SPI/DMA chain comes
+    // next, as it paces the SPI traffic.
+    arm::Interrupt::setPriority(i_PINT.exINT0, 0);      // INTA
+    arm::Interrupt::setPriority(i_PINT.exINT1, 0);      // INTB
+#if VARIANT_CHANNELS > 2
+    arm::Interrupt::setPriority(i_PINT.exINT2, 0);      // INTC
+    arm::Interrupt::setPriority(i_PINT.exINT3, 0);      // INTD
+#endif
+    arm::Interrupt::setPriority(i_PINT.exINT4, 0);      // BLS
+    arm::Interrupt::setPriority(i_DMA0.exDMA, 1);
+    arm::Interrupt::setPriority(i_SPI0.exSPI, 1);
+    arm::Interrupt::setPriority(i_FTM0.exFTM, 2);
+    arm::Interrupt::setPriority(i_FTM1.exFTM, 2);
+    arm::Interrupt::setPriority(i_WKT.exWKT, 2);
+    arm::Interrupt::setPriority(i_MRT0.exMRT, 2);
+    arm::Interrupt::setPriority(i_I2C0.exI2C, 3);
+#if VARIANT_AES42
+    arm::Interrupt::setPriority(i_ADC0.exTHCMP, 3);
+#endif
+
+    clktree.register_fields[1].set(static_cast<Clocks*>(&clktree), froHz);
+    timers.start(0, 60000);     // 1 ms at the 60 MHz system clock, the bring-up times count from here
 
     print("AES42HAT\n");
 
-    ChannelManagement mgmt{chan};
+#if HANDLER_PROFILE
+    board.attach(BoardControl::winProfile, Handler::profile());
+#endif
+#if BENCH_ENABLE
+    board.attach(BoardControl::winBench, bench::run());
+#endif
+
+#if VARIANT_AES42
+    board.attach(BoardControl::winPhantom, adc.readout());
+#endif
+    board.attach(BoardControl::winSpi, spique.stats(), BoardControl::counters);
+    board.attach(BoardControl::winChannels, Channel::stats(), BoardControl::counters);
+    board.attach(BoardControl::winStatus, Channel::status());
+    board.attach(BoardControl::winEvents, Channel::events(), BoardControl::counters);
+    board.attach(BoardControl::winRatio, ratioMon.drift());
+    board.attach(BoardControl::winTasks, task::poolStats());
+    board.attach(BoardControl::winBringUp, mgmt.bringUp());
+    board.attach(BoardControl::winConfig, config.stats());
+    board.attach(BoardControl::winCaptures, captures.timing());
+    board.attach(BoardControl::winSpiPlan, std::as_writable_bytes(std::span(&spiBudget, 1)));
+    board.attach(BoardControl::cmdSave, configSave);
+
     mgmt.post();
+    ratioMon.start();
 
     Handler::run();
 
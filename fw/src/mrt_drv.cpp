@@ -0,0 +1,53 @@
+/** @file
+ * driver for the LPC8 MRT
+ * @addtogroup LPC865_mrt
+ * @ingroup LPC865
+ * @{
+ */
+module;
+#include <bit>
+#include <cstdint>
+module mrt_drv;
+import MRT;
+
+using namespace lpc865::MRT;
+
+void lpc865::Mrt::isr() {
+    auto &hw = *in_.registers;
+    uint32_t flags = hw.IRQ_FLAG.val();
+    hw.IRQ_FLAG.set(flags);         // write 1 to clear
+    while (flags) {
+        unsigned chan = std::countr_zero(flags);
+        flags &= flags - 1;
+        if (chan >= channels)
+            break;
+        ticks_[chan] = ticks_[chan] + 1;
+        if (hdl_[chan])
+            hdl_[chan]->post();
+    }
+}
+
+void lpc865::Mrt::startRepeat(unsigned chan, uint32_t interval, Handler &hdl) {
+    auto &hw = *in_.registers;
+    hdl_[chan] = &hdl;
+    ticks_[chan] = 0;
+    hw.CHANNEL[chan].CTRL = CHANNEL_CTRL{ .INTEN = 1, .MODE = 0 };     // repeat interrupt mode
+    hw.CHANNEL[chan].INTVAL = CHANNEL_INTVAL{ .IVALUE = interval, .LOAD = 1 };
+}
+
+void lpc865::Mrt::stop(unsigned chan) {
+    auto &hw = *in_.registers;
+    hw.CHANNEL[chan].INTVAL = CHANNEL_INTVAL{ .IVALUE = 0, .LOAD = 1 };
+    hw.CHANNEL[chan].CTRL = CHANNEL_CTRL{ .INTEN = 0 };
+    hdl_[chan] = nullptr;
+}
+
+lpc865::Mrt::Mrt(Intgr const &in)
+    : in_{in}
+    , hdl_{}
+    , ticks_{}
+{
+    bind(in_.exMRT);
+}
+
+/** @}*/
@@ -0,0 +1,55 @@
+/** @file
+ * driver for the LPC8 MRT.
+ *
+ * @addtogroup LPC865_mrt
+ * @ingroup LPC865
+ * @{
+ */
+
+module;
+#include <cstddef>
+#include <cstdint>
+export module mrt_drv;
+import nvic_drv;
+import handler;
+import MRT;
+
+export namespace lpc865 {
+
+/** MRT Driver.
+ *
+ * Each of the four channels can run as a repeating timer that posts a
+ * handler on every expiry. The interrupt also counts the expiries, so that
+ * the handler can catch up with the ones it has missed by being late.
+ */
+class Mrt : public arm::Interrupt {
+public:
+    static constexpr unsigned channels = 4;     //!< Number of timer channels
+
+    void isr() override;
+
+    /** Start a channel in repeat mode.
+     * @param chan Channel number
+     * @param interval Period in system clock cycles, at most 2^31-1
+     * @param hdl Handler to post on each expiry
+     */
+    void startRepeat(unsigned chan, uint32_t interval, Handler &hdl);
+
+    /** Stop a channel. */
+    void stop(unsigned chan);
+
+    /** Number of expiries of a channel since it was started. This wraps around. */
+    uint32_t ticks(unsigned chan) const { return ticks_[chan]; }
+
+    explicit Mrt(MRT::Intgr const &in);
+    ~Mrt() =default;
+
+private:
+    MRT::Intgr const &in_;  //!< Integration values
+    Handler *hdl_[channels];
+    uint32_t volatile ticks_[channels];
+};
+
+} // namespace
+
+//!@}
@@ -138,7 +138,7 @@ extern unsigned __bss_section_table_end;    //!< end of bss section table
  * Call this in startup code after calling sysinit() and before calling __libc_init_array().
  */
 __attribute__((always_inline)) inline void startup_meminit(void) {
-    // Initialize the .data segment from .text
+    // Initialize the .data and .ramfunc segments from .text
     for(unsigned *dp = &__data_section_table; dp < &__data_section_table_end; ) {
         unsigned const *src = (unsigned const *)(*dp++);
         unsigned *dest = (unsigned *)(*dp++);
@@ -9,7 +9,9 @@
 module;
 #include "newlib_def.h"
 #include "externs.h"
+#include "ramfunc.h"
 #include <array>
+#include <bit>
 #include <cstddef>
 #include <cstdint>
 module nvic_drv;
@@ -18,6 +20,12 @@ import NVIC;
 
 static hwreg::HwPtr<volatile arm::NVIC::NVIC> const nvic = 0xE000E100;
 
+/** SysTick registers CSR, RVR, CVR and CALIB. */
+static auto *const systick = reinterpret_cast<uint32_t volatile *>(0xE000E010);
+
+/** Vector table offset register in the system control block. */
+static auto *const vtor = reinterpret_cast<uintptr_t volatile *>(0xE000ED08);
+
 using namespace lpc865;
 
 constexpr std::array<arm::Interrupt::VectorTableEntry*, 16> specific_handlers = {
@@ -81,6 +89,13 @@ void arm::Interrupt::insert(Exception n) {
     }
 }
 
+void arm::startCycleCounter() {
+    systick[0] = 0;         // stop counter
+    systick[1] = 0xFFFFFF;  // maximum reload value
+    systick[2] = 0;         // any write clears the current value
+    systick[0] = 0x5;       // CLKSOURCE = CPU clock, ENABLE, no interrupt
+}
+
 void arm::Interrupt::enable(Exception n) {
     if(n >= interruptOffset) {
         unsigned index = (n-interruptOffset) >> 5;
@@ -97,13 +112,22 @@ void arm::Interrupt::disable(Exception n) {
     }
 }
 
+void arm::Interrupt::setPriority(Exception n, uint8_t prio) {
+    if(n >= interruptOffset) {
+        unsigned index = (n-interruptOffset) >> 2;
+        unsigned shift = ((n-interruptOffset) & 0x3) * 8;
+        uint32_t ipr = nvic->IPR[index].val() & ~(0xFFu << shift);
+        nvic->IPR[index] = ipr | (uint32_t(prio & 0x3) << (shift + 6));   // only bits 7:6 are implemented
+    }
+}
+
 /** Default interrupt service routine.
  *
  * This routine dispatches the interrupt call to the object(s) registered in the
  * `interrupt_table`. It is the routine that is used in the vector table, unless
  * a different routine is specified in the `specific_handlers` array.
  */
-void arm::Interrupt::defaultISR() {
+RAMFUNC void arm::Interrupt::defaultISR() {
     unsigned exnum;
     void *stack;
     asm volatile (" mov %0, LR " : "=r" (exnum));       // get exception return address
@@ -121,6 +145,19 @@ void arm::Interrupt::defaultISR() {
         h->isr();
 }
 
+/** Direct interrupt service routine.
+ *
+ * This routine is entered into the vector table by bind(), for exceptions that
+ * are served by a single object. The object is the first entry of the ring in
+ * the `interrupt_table`, and it is called without further checks.
+ */
+RAMFUNC void arm::Interrupt::directISR() {
+    unsigned exnum;
+    asm volatile (" mrs %0, IPSR " : "=r" (exnum));     // get exception number
+    interrupt_table[exnum]->isr();
+    setActivityLED(true);
+}
+
 /** Vector table initialization function.
  * @tparam N Number of entries in the vector table
  * @tparam M Number of special entries at the beginning
@@ -148,3 +185,26 @@ make_vector_table(std::array<arm::Interrupt::VectorTableEntry*, M> initial_entri
 __attribute__((used, section(".isr_vector")))
 std::array<arm::Interrupt::VectorTableEntry *, lpc865::interruptCount> const vector_table
     = make_vector_table<interrupt_table.size(), specific_handlers.size()>(specific_handlers);
+
+/** The interrupt vector table in RAM.
+ *
+ * This copy of the vector table is used as soon as an exception vector needs
+ * to be bound to a specific routine at runtime. The table must be aligned to
+ * its size rounded up to a power of two.
+ */
+alignas(std::bit_ceil(sizeof(vector_table))) static std::array<arm::Interrupt::VectorTableEntry *, lpc865::interruptCount> ram_vector_table;
+
+bool arm::Interrupt::bind(Exception n) {
+    auto h = get_head(n);
+    if(!h || h->link_) {
+        insert(n);      // exception is shared, or invalid
+        return false;
+    }
+    if(*vtor != reinterpret_cast<uintptr_t>(ram_vector_table.data())) {
+        ram_vector_table = vector_table;
+        *vtor = reinterpret_cast<uintptr_t>(ram_vector_table.data());
+    }
+    ram_vector_table[n] = &directISR;
+    insert(n);          // forms a ring of one, and enables the interrupt
+    return true;
+}
@@ -26,7 +26,40 @@ __attribute__((always_inline)) inline void wfe(void) {
     asm volatile ("wfe");
 }
 
+/** Start SysTick as a free running cycle counter.
+ *
+ * The counter is clocked from the CPU clock, counts down and wraps around
+ * after 2^24 cycles. No interrupt is generated.
+ */
+void startCycleCounter();
+
+/** Read the current value of the cycle counter. */
+__attribute__((always_inline)) inline uint32_t cycleCount() {
+    return *reinterpret_cast<uint32_t const volatile *>(0xE000E018);   // SysTick CVR
+}
+
+/** Number of cycles elapsed between two readings of the cycle counter.
+ * Correct as long as less than 2^24 cycles have elapsed.
+ */
+__attribute__((always_inline)) inline uint32_t cycleDiff(uint32_t from, uint32_t to) {
+    return (from - to) & 0xFFFFFF;  // the counter counts down
+}
+
 
+/** Interrupt service object.
+ *
+ * Objects register themselves for an exception with insert(), which links
+ * them into a ring of objects sharing the exception. The vector table points
+ * to defaultISR(), which walks the ring and calls isr() of each object.
+ *
+ * An object that is the only one serving an exception can use bind()
+ * instead. This redirects the exception's vector to directISR(), which calls
+ * the object's isr() without walking the ring. Since the vector table in
+ * flash is constant, the first call to bind() moves the vector table to RAM.
+ *
+ * Interrupt priorities are set with setPriority(). By default all external
+ * interrupts have the highest priority, so none can preempt another.
+ */
 class Interrupt {
     Interrupt(Interrupt &&) =delete;
 protected:
@@ -40,7 +73,26 @@ public:
     void enable(Exception);
     void disable(Exception);
     void insert(Exception);
+
+    /** Serve an exception exclusively, with a direct vector.
+     * @param n Exception number
+     * @return true if the vector was bound directly to this object. false if
+     * other objects already share the exception, in which case this object
+     * is inserted into the ring like with insert().
+     */
+    bool bind(Exception n);
+
+    /** Set the priority of an external interrupt.
+     * @param n Exception number
+     * @param prio Priority level, 0 (highest) .. 3 (lowest)
+     *
+     * The Cortex-M0+ implements two priority bits. A higher priority
+     * interrupt preempts the service routine of a lower priority interrupt.
+     */
+    static void setPriority(Exception n, uint8_t prio);
+
     static void defaultISR();
+    static void directISR();
 
 private:
     static Interrupt *get_head(Exception n);
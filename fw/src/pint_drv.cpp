@@ -27,7 +27,7 @@ constexpr Exception getEx(unsigned num, Intgr const &in) {
 }
 
 void lpc865::Pint::attach(unsigned num, uint8_t mode, arm::Interrupt &intr) {
-    intr.insert(getEx(num, in_));
+    intr.bind(getEx(num, in_));     // each pin interrupt has its own exception
     enable(num, mode);
 }
 
@@ -20,6 +20,9 @@ class Pint {
 public:
     /** Attach and enable pin interrupt.
      * @param mode 0: none, 1: rising edge, 2: falling edge, 3: both edges, 4: low level, 5: high level
+     *
+     * The interrupt object is bound directly to the exception vector of the
+     * pin interrupt, so it should be the only one attached to this number.
      */
     void attach(unsigned num, uint8_t mode, arm::Interrupt &intr);
 
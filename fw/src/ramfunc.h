@@ -0,0 +1,24 @@
+/** @file
+ * Placement of time critical functions in RAM.
+ */
+#pragma once
+
+/** Attribute for functions that are executed from RAM.
+ *
+ * Code executed from flash suffers from flash wait states. Functions marked
+ * with this attribute are placed in the .ramfunc section, which the linker
+ * script locates in RAM, with its initial image in flash. The startup code
+ * copies it to RAM together with the .data section, so those functions must
+ * not be called from sysinit(). They are not inlined into their callers, as
+ * that would bring them back into flash.
+ *
+ * RAM is scarce, so this should only be used for the hot paths, i.e. interrupt
+ * service routines and the handler dispatch. The build prints a report of the
+ * functions placed in RAM and their sizes. The build option AES42HAT_RAMFUNC
+ * turns the relocation off, for comparing the timing.
+ */
+#if RAMFUNC_ENABLE
+#define RAMFUNC __attribute__((section(".ramfunc"), noinline))
+#else
+#define RAMFUNC
+#endif
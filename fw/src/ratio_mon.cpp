@@ -0,0 +1,63 @@
+/** @file
+ * SRC ratio telemetry.
+ * @addtogroup AES42HAT_clk
+ * @ingroup AES42HAT
+ * @{
+ */
+module;
+#include <cstddef>
+#include <cstdint>
+#include <span>
+module ratio_mon;
+
+/** Add the sample taken since the last tick to the window. */
+void RatioMonitor::collect(unsigned n) {
+    auto &a = acc_[n];
+    auto &o = out_[n];
+    auto const &ch = channels_[n];
+    if (ch.ratioSeq() == a.seq) {
+        ++o.missed;
+        return;
+    }
+    a.seq = ch.ratioSeq();
+    uint16_t r = ch.ratio();
+    o.last = r;
+    if (a.count == 0 || r < a.min)
+        a.min = r;
+    if (a.count == 0 || r > a.max)
+        a.max = r;
+    a.sum += r;
+    if (++a.count < par_.window)
+        return;
+    o.min = a.min;
+    o.max = a.max;
+    o.mean = uint16_t((a.sum + a.count / 2) / a.count);
+    ++o.windows;
+    a.sum = 0;
+    a.count = 0;
+}
+
+void RatioMonitor::act() {
+    for (unsigned n = 0; n < Channel::maxChannels; ++n) {
+        collect(n);
+        channels_[n].sampleRatio();
+    }
+}
+
+void RatioMonitor::start() {
+    for (unsigned n = 0; n < Channel::maxChannels; ++n)
+        channels_[n].sampleRatio();
+    wheel_.arm(timer_, par_.interval);
+}
+
+RatioMonitor::RatioMonitor(Parameters const &par, TimerWheel &wheel, Channel *channels)
+    : par_{par}
+    , wheel_{wheel}
+    , timer_{*this, par.interval}
+    , channels_{channels}
+    , acc_{}
+    , out_{}
+{
+}
+
+/** @}*/
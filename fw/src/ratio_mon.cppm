@@ -0,0 +1,78 @@
+/** @file
+ * SRC ratio telemetry.
+ *
+ * @addtogroup AES42HAT_clk
+ * @ingroup AES42HAT
+ * @{
+ */
+
+module;
+#include <cstddef>
+#include <cstdint>
+#include <span>
+export module ratio_mon;
+import handler;
+import timer;
+import channel;
+
+/** Periodic sampling of the SRC ratio readback of all channels.
+ *
+ * The ratio readback shows how far the clock of each input drifts from the
+ * local wordclock, so a failing clock shows up in it before the audio drops.
+ * A periodic timer paces the samples. On each tick the monitor asks every channel for
+ * a new sample, which the channel reads at low priority, when the SPI is
+ * idle, so that it doesn't delay the block fetches. The samples are collected
+ * on the next tick, and aggregated over windows of a fixed number of samples.
+ * The minimum, maximum and mean of the last complete window are published.
+ */
+export class RatioMonitor : public Handler {
+public:
+    /** Operating parameters. */
+    struct Parameters {
+        uint32_t interval;      //!< Sampling interval in timer ticks
+        uint16_t window;        //!< Samples per window
+    };
+
+    /** Drift statistics of a channel, in units of the raw ratio readback. */
+    struct Drift {
+        uint16_t last;          //!< Most recent sample
+        uint16_t min;           //!< Minimum in the last window
+        uint16_t max;           //!< Maximum in the last window
+        uint16_t mean;          //!< Mean of the last window
+        uint16_t windows;       //!< Number of complete windows so far
+        uint16_t missed;        //!< Ticks that found no new sample
+    };
+
+    void act() override;
+
+    /** Get the drift statistics, for exposing them to the host. */
+    std::span<std::byte> drift() {
+        return std::as_writable_bytes(std::span(out_));
+    }
+
+    /** Request the first samples, and arm the timer. */
+    void start();
+
+    RatioMonitor(Parameters const &par, TimerWheel &wheel, Channel *channels);
+
+private:
+    /** Aggregation of the current window. */
+    struct Acc {
+        uint32_t sum;
+        uint16_t min;
+        uint16_t max;
+        uint16_t count;
+        uint8_t seq;            //!< Sample sequence number of the channel last seen
+    };
+
+    void collect(unsigned n);
+
+    Parameters const &par_;
+    TimerWheel &wheel_;
+    Timer timer_;
+    Channel *channels_;
+    Acc acc_[Channel::maxChannels];
+    Drift out_[Channel::maxChannels];
+};
+
+//!@}
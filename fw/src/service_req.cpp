@@ -0,0 +1,66 @@
+/** @file
+ * Service request status on the I2C target interface.
+ * @addtogroup AES42HAT_ctrl
+ * @ingroup AES42HAT
+ * @{
+ */
+module;
+#include <cstddef>
+#include <cstdint>
+#include "externs.h"
+module service_req;
+import nvic_drv;
+
+void ServiceRequest::update(uint16_t bits, uint16_t value) {
+    arm::disable_irq();
+    status_ = (status_ & ~bits) | (value & bits);
+    signal();
+    arm::enable_irq();
+}
+
+void ServiceRequest::setMask(uint16_t mask) {
+    arm::disable_irq();
+    mask_ = mask;
+    signal();
+    arm::enable_irq();
+}
+
+void ServiceRequest::signal() {
+    setRequestLine((status_ & mask_) != 0);
+}
+
+bool ServiceRequest::select(uint8_t tgt) {
+    if ((tgt >> 1) != addr_)
+        return false;
+    latched_ = status_;     // both bytes from the same instant
+    index_ = 0;
+    return true;
+}
+
+void ServiceRequest::deselect() {
+}
+
+uint8_t ServiceRequest::getTxByte() {
+    switch (index_++) {
+    case 0:
+        return uint8_t(latched_);
+    case 1:
+        return uint8_t(latched_ >> 8);
+    default:
+        return 0;
+    }
+}
+
+void ServiceRequest::putRxByte(uint8_t) {
+}
+
+ServiceRequest::ServiceRequest(uint8_t addr)
+    : status_{0}
+    , mask_{0xFFFF}
+    , latched_{0}
+    , index_{0}
+    , addr_{addr}
+{
+}
+
+/** @}*/
@@ -0,0 +1,67 @@
+/** @file
+ * Service request status on the I2C target interface.
+ *
+ * @addtogroup AES42HAT_ctrl
+ * @ingroup AES42HAT
+ * @{
+ */
+
+module;
+#include <cstddef>
+#include <cstdint>
+export module service_req;
+import i2c_tgt_drv;
+
+/** Service request status.
+ *
+ * The status word has a bit for each condition that needs the attention of
+ * the host processor. As long as any bit is set that isn't masked, the REQ
+ * signal is active. A bit stays set until the condition it represents has
+ * been serviced, i.e. its owner clears it.
+ *
+ * The host reads the status word at its own I2C address, without sending a
+ * register address first, low byte first. The mask is accessed through the
+ * board control registers.
+ */
+export class ServiceRequest : public lpc865::I2cTarget::Callback {
+public:
+    /** Status bits. */
+    enum Bit : uint16_t {
+        srPhantomA  = 0x0001,   //!< Phantom voltage of channel A out of range
+        srPhantomB  = 0x0002,   //!< Phantom voltage of channel B out of range
+        srPhantomC  = 0x0004,   //!< Phantom voltage of channel C out of range
+        srPhantomD  = 0x0008,   //!< Phantom voltage of channel D out of range
+        srPhantom   = 0x000F,   //!< All phantom voltage bits
+    };
+
+    /** Change status bits.
+     * This may be called from interrupt context.
+     * @param bits The bits to change
+     * @param value The new values of the bits
+     */
+    void update(uint16_t bits, uint16_t value);
+
+    uint16_t status() const { return status_; }
+    uint16_t mask() const { return mask_; }
+
+    /** Set the mask of status bits that activate the REQ signal. */
+    void setMask(uint16_t mask);
+
+    bool select(uint8_t) override;
+    void deselect() override;
+    uint8_t getTxByte() override;
+    void putRxByte(uint8_t) override;
+
+    explicit ServiceRequest(uint8_t addr);
+
+private:
+    void signal();
+
+    uint16_t volatile status_;  //!< Service request status
+    uint16_t mask_;             //!< Bits that activate the REQ signal
+    uint16_t latched_;          //!< Status word being transmitted
+    uint8_t index_;             //!< Index of the next byte to transmit
+    uint8_t const addr_;        //!< 7-bit I2C address
+};
+
+//!@}
@@ -7,15 +7,35 @@
 module;
 #include <cstddef>
 #include <cstdint>
+#include "ramfunc.h"
 module spi_drv;
 import SPI;
 
 using namespace lpc865::SPI;
 
-bool lpc865::Spi::target(Parameters const &par, Handler *hdl) {
+/** Set the divider and delays. The controller is idle between transfers. */
+void lpc865::Spi::apply(Plan const &p) {
+    auto &hw = *in_.registers;
+    hw.DIV.set(p.div);
+    hw.DLY = DLY{ .PRE_DELAY = p.pre, .POST_DELAY = p.post, .TRANSFER_DELAY = p.gap };
+    applied_ = &p;
+}
+
+bool lpc865::Spi::target(Parameters const &par, Handler *hdl, uint32_t speed) {
     if (par.sel & 0xF0)
         return false;
     hdl_ = hdl;
+    uint32_t limit = speedHz(par.cmd.maxHz);
+    if (speed && (!limit || speed < limit))
+        limit = speed;
+    unsigned rd = par.cmd.read;
+    if (limit != limits_[rd]) {
+        limits_[rd] = limit;
+        plans_[rd] = plan(clk_, limit, rd);
+        applied_ = nullptr;
+    }
+    if (applied_ != &plans_[rd])
+        apply(plans_[rd]);
     auto &hw = *in_.registers;
     auto txctl = hw.TXCTL.get();
     txctl.TXSSEL0_N = !(par.sel & 0x01);
@@ -40,7 +60,7 @@ bool lpc865::Spi::target(Parameters const &par, Handler *hdl) {
     return true;
 }
 
-ptrdiff_t lpc865::Spi::transfer(void *buf, size_t size, uint32_t speed) {
+ptrdiff_t lpc865::Spi::transfer(void *buf, size_t size) {
     auto &hw = *in_.registers;
     auto stat = hw.STAT.get();
     if (!stat.MSTIDLE)
@@ -91,15 +111,20 @@ auto lpc865::Spi::status() const -> Status {
     return idle;
 }
 
-lpc865::Spi::Spi(Intgr const &in, Dma *dma)
-    : in_{in}
+lpc865::Spi::Spi(Intgr const &in, Dma *dma, Clocking const &clk)
+    : Handler{readySet}
+    , in_{in}
     , dma_{dma}
+    , hdl_{nullptr}
+    , clk_{clk}
+    , limits_{}
+    , plans_{ plan(clk, 0, false), plan(clk, 0, true) }
+    , applied_{nullptr}
 {
     auto &hw = *in_.registers;
-    hw.DIV.set(11);  // divide by 12
-    hw.DLY = DLY{ .PRE_DELAY = 1, .POST_DELAY = 1 };
+    apply(plans_[1]);
     hw.CFG = CFG{ .ENABLE = 1, .MASTER = 1 };
-    insert(in_.exSPI);
+    bind(in_.exSPI);
 }
 
 // This gets called when the DMA controller generated an interrupt for the SPI-assigned channels.
@@ -109,7 +134,7 @@ void lpc865::Spi::act() {
 }
 
 // This gets called when the SPI generates an interrupt request.
-void lpc865::Spi::isr() {
+RAMFUNC void lpc865::Spi::isr() {
     auto &hw = *in_.registers;
     auto stat = hw.STAT.get();
     hw.STAT = stat;     // clear pending interrupts
@@ -7,8 +7,10 @@
  */
 
 module;
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <iterator>
 export module spi_drv;
 import handler;
 import nvic_drv;
@@ -21,6 +23,7 @@ export namespace lpc865 {
  * This is a generic interface for the controller of an SPI port. The following
  * features can be supported:
  * - Multiple target selects.
+ * - The fastest clock each transfer allows, see plan().
  */
 class Spi : public arm::Interrupt, public Handler {
 public:
@@ -173,8 +176,75 @@ public:
         uint32_t sel:8;     //!< Up to 8 target selects
     };
 
-    bool target(Parameters const &par, Handler *hdl);
-    ptrdiff_t transfer(void *buf, size_t size, uint32_t speed=0);
+    /** Timing limits of the bus and the targets on it, for planning the clock.
+     * The SSEL delays are minimum times, which the planner rounds up to
+     * whole SCK periods.
+     */
+    struct Clocking {
+        uint32_t fclk;      //!< SPI function clock in Hz, as set up in the clock tree
+        uint32_t maxHz;     //!< Fastest SCK the controller and the board allow
+        uint16_t readNs;    //!< Shortest SCK period for reads, i.e. twice the targets' output delay plus the input setup time
+        uint16_t leadNs;    //!< Time from SSEL asserted to the first SCK edge
+        uint16_t lagNs;     //!< Time from the last SCK edge to SSEL deasserted
+        uint16_t gapNs;     //!< Time SSEL stays deasserted between transfers
+    };
+
+    /** Clock divider and delays of a transfer. */
+    struct Plan {
+        uint32_t hz;        //!< Resulting SCK frequency
+        uint16_t div;       //!< DIV register value, SCK = fclk / (div + 1)
+        uint8_t pre;        //!< DLY.PRE_DELAY, in SCK periods
+        uint8_t post;       //!< DLY.POST_DELAY, in SCK periods
+        uint8_t gap;        //!< DLY.TRANSFER_DELAY, in SCK periods
+
+        /** Duration of a transfer in ns, including the SSEL delays. */
+        constexpr uint32_t ns(uint32_t bytes) const {
+            // One SCK period each before and after the data, and between
+            // transfers, is inserted by the controller anyway.
+            uint32_t periods = bytes * 8 + pre + post + gap + 3;
+            return uint32_t(uint64_t(periods) * 1000000000u / hz);
+        }
+    };
+
+    /** Frequency in Hz of a maxHz code, 0 for mHzUndef. */
+    static constexpr uint32_t speedHz(unsigned code) {
+        constexpr uint16_t mhz[] = { 0, 33, 50, 66, 80, 100, 133, 166, 200, 250, 266, 333, 400 };
+        return code < std::size(mhz) ? mhz[code] * 1000000u : 0;
+    }
+
+    /** Find the fastest legal clock of a transfer.
+     * @param clk Limits of the bus
+     * @param limit Fastest SCK the target allows for the command, in Hz, 0 if
+     *        there's no limit other than the bus
+     * @param read True if the transfer has a read data phase
+     */
+    static constexpr Plan plan(Clocking const &clk, uint32_t limit, bool read) {
+        uint32_t hz = limit ? std::min(limit, clk.maxHz) : clk.maxHz;
+        uint32_t khz = clk.fclk / 1000;
+        uint32_t n = (clk.fclk + hz - 1) / hz;      // division of fclk, at least 1
+        if (read)
+            n = std::max(n, (clk.readNs * khz + 999999) / 1000000);
+        n = std::clamp<uint32_t>(n, 1, 0x10000);
+        // Whole SCK periods covering a time, not counting the one period the
+        // controller always inserts.
+        auto periods = [&](uint16_t ns) {
+            uint32_t ticks = (ns * khz + 999999) / 1000000;
+            uint32_t p = (ticks + n - 1) / n;
+            return uint8_t(std::clamp<uint32_t>(p, 1, 16) - 1);
+        };
+        return { clk.fclk / n, uint16_t(n - 1), periods(clk.leadNs), periods(clk.lagNs), periods(clk.gapNs) };
+    }
+
+    /** Select the target, and set the clock for the command.
+     * @param par Transfer parameters. The clock is limited by cmd.maxHz.
+     * @param hdl Completion handler
+     * @param speed Further limit of the clock in Hz, 0 for none
+     *
+     * The plans for the last read and write limits are kept, so that
+     * alternating between reads and writes doesn't replan each time.
+     */
+    bool target(Parameters const &par, Handler *hdl, uint32_t speed = 0);
+    ptrdiff_t transfer(void *buf, size_t size);
 
     enum Status {
         uninitialized,  //!< Controller is not initialized or disabled
@@ -187,16 +257,22 @@ public:
      */
     Status status() const;
 
-    Spi(SPI::Intgr const &in, Dma *dma);
+    Spi(SPI::Intgr const &in, Dma *dma, Clocking const &clk);
     ~Spi() =default;
 
     void act() override;
     void isr() override;
 
 private:
+    void apply(Plan const &p);
+
     SPI::Intgr const &in_;
     Dma *dma_;
     Handler *hdl_;
+    Clocking const &clk_;
+    uint32_t limits_[2];        //!< Limits the plans were made for, by read flag
+    Plan plans_[2];             //!< Plans for the last write and read limits
+    Plan const *applied_;       //!< Plan set in the registers
 };
 
 } // namespace
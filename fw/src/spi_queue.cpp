@@ -4,28 +4,47 @@
  * @ingroup LPC865
  * @{
  */
+module;
+#include <bit>
+#include <cstddef>
+#include <cstdint>
 module spi_queue;
 
-
 void lpc865::SpiQueue::enqueue(Entry &e) {
-    bool empty = queue_.empty();
     queue_.push_back(e);
-    if (empty)
+    if (!busy_) {
+        busy_ = true;
         handle(e);
+    }
 }
 
 void lpc865::SpiQueue::act() {
+    // The entry leaves the queue before its completion handler runs, so that
+    // the handler can enqueue it again for the next transfer of a sequence.
     auto &e = queue_.front();
+    queue_.pop_front();
     if (e.hdl)
         e.hdl->act();
-    queue_.pop_front();
     if (!queue_.empty())
         handle(queue_.front());
+    else
+        busy_ = false;
+}
+
+void lpc865::SpiQueue::count(Entry const &e) {
+    auto const &cmd = e.par.cmd;
+    uint32_t cmdBytes = !e.par.noins + cmd.addb + (cmd.dummy + cmd.mclks + 7) / 8;
+    ++stats_.transfers;
+    stats_.dataBytes += e.size;
+    stats_.cmdBytes += cmdBytes;
+    if (unsigned sel = std::countr_zero(uint8_t(e.par.sel)); sel < std::size(stats_.selBytes))
+        stats_.selBytes[sel] += e.size + cmdBytes;
 }
 
 void lpc865::SpiQueue::handle(Entry &e) {
-    spi_.target(e.par, this);
-    spi_.transfer(e.buf, e.size, e.speed);
+    count(e);
+    spi_.target(e.par, this, e.speed);
+    spi_.transfer(e.buf, e.size);
 }
 
 /** @}*/
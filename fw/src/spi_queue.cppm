@@ -9,6 +9,7 @@
 module;
 #include <cstddef>
 #include <cstdint>
+#include <span>
 export module spi_queue;
 import spi_drv;
 import queuering;
@@ -16,7 +17,11 @@ import handler;
 
 export namespace lpc865 {
 
-/** WKT Driver.
+/** Queue of SPI transfers.
+ *
+ * The transfers are executed in order. The completion handler of an entry is
+ * called synchronously from the queue's handler, and may enqueue further
+ * transfers.
  */
 class SpiQueue : public Handler {
 public:
@@ -28,25 +33,50 @@ public:
         Spi::Parameters par = {};
         void *buf = nullptr;
         size_t size = 0;
-        uint32_t speed = 0;
+        uint32_t speed = 0;         // clock limit in Hz on top of par.cmd.maxHz, 0 for none
         Handler *hdl = nullptr;     // completion handler
         Entry *next = nullptr;      // for forming linked list of entries
     };
 
+    /** Traffic statistics.
+     * Command bytes are the instruction, address and dummy phases, as
+     * opposed to the data phase. Counters wrap around.
+     */
+    struct Stats {
+        uint32_t transfers;         //!< Number of transfers started
+        uint32_t dataBytes;         //!< Bytes in data phases
+        uint32_t cmdBytes;          //!< Bytes in command phases
+        uint32_t selBytes[4];       //!< Bytes of both kinds for target selects 0..3
+    };
+
     void enqueue(Entry &e);
 
     void act() override;
 
+    /** True if no transfer is in progress or waiting. */
+    bool idle() const { return !busy_; }
+
+    /** Get the traffic statistics, for exposing them to the host. */
+    std::span<std::byte> stats() {
+        return std::as_writable_bytes(std::span(&stats_, 1));
+    }
+
     explicit SpiQueue(Spi &spi)
-        : spi_{spi}
+        : Handler{readySet}
+        , spi_{spi}
+        , stats_{}
+        , busy_{false}
     {
     }
 
 private:
     void handle(Entry &e);
+    void count(Entry const &e);
 
     Spi &spi_;
     QueueRing<Entry> queue_;
+    Stats stats_;
+    bool busy_;                 //!< A transfer or its completion handler is in progress
 };
 
 } // namespace
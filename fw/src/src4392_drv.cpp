@@ -6,33 +6,119 @@
 
 module;
 #include <algorithm>
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <span>
 module src4392_drv;
 import spi_drv;
+import aes3;
 import SRC4392;
 
 
 namespace src4392 {
 
-Src4392::Src4392(SRC4392::Intgr const &in, Handler *hdl)
-    : entry_{
-        .par = {
-            .cmd = {
-                .pu = lpc865::Spi::pu1S1S1S,
-                .maxHz = lpc865::Spi::mHz33,
-                .write = 1,
-                .dummy = 8
-            },
-            .type = lpc865::Spi::spiMode0,
-            .sel = 1U << in.addr
+// The channel status bytes of subchannels A and B are interleaved in the buffers
+static constexpr size_t csStride = 2;
+
+// Output data source field in the port A and B control registers 1
+static constexpr uint8_t portRegs[] = { 0x03, 0x05 };
+static constexpr uint8_t outSourceMask = 0x30;
+static constexpr uint8_t outSourceDir = 0x20;
+static constexpr uint8_t outSourceSrc = 0x30;
+
+// Instruction and dummy byte of each transfer, and the page register
+static constexpr int32_t cmdBytes = 2;
+static constexpr uint8_t pageReg = 0x7F;
+
+std::array<std::byte, 4> Src4392::pageValues_ = { std::byte{0}, std::byte{1}, std::byte{2}, std::byte{3} };
+
+/** SPI parameters of a transfer to the chips given by sel. */
+lpc865::Spi::Parameters Src4392::params(uint8_t sel) {
+    return {
+        .cmd = {
+            .pu = lpc865::Spi::pu1S1S1S,
+            .maxHz = maxSpeed,
+            .write = 1,
+            .dummy = 8
         },
-        .buf = nullptr,
-        .size = 0,
-        .hdl = hdl
+        .type = lpc865::Spi::spiMode0,
+        .sel = sel
+    };
+}
+
+void Src4392::broadcast(lpc865::SpiQueue &spiq, std::span<lpc865::SpiQueue::Entry, 2> entries,
+                        std::span<std::byte const> regs, uint8_t all, uint8_t sel, Handler *hdl) {
+    auto &page = entries[0];
+    page.par = params(all);
+    page.par.cmd.ins = pageReg;
+    page.buf = &pageValues_[0];
+    page.size = 1;
+    page.hdl = sel ? nullptr : hdl;
+    spiq.enqueue(page);
+    if (!sel)
+        return;
+    auto &data = entries[1];
+    data.par = params(sel);
+    data.par.cmd.ins = 0x01;
+    data.buf = const_cast<std::byte *>(regs.data());
+    data.size = regs.size();
+    data.hdl = hdl;
+    spiq.enqueue(data);
+}
+
+void Src4392::initRegs(std::span<std::byte const> base, std::span<Override const> overrides) {
+    std::ranges::copy(base.first(std::min(base.size(), regs_.size())), regs_.begin());
+    for (auto const &o : overrides)
+        if (o.reg >= 0x01 && o.reg <= regs_.size())
+            regs_[o.reg - 1] = o.value;
+}
+
+std::array<std::span<std::byte const>, Src4392::configParts> Src4392::config() {
+    static_assert(portRegs[0] == 0x03 && portRegs[1] == 0x05, "the parts are split around the port registers");
+    for (unsigned p = 0; p < std::size(portRegs); ++p) {
+        std::byte reg = regs_[portRegs[p] - 1];
+        if ((bypassed_ & (1u << p)) && (uint8_t(reg) & outSourceMask) == outSourceDir)
+            reg = (reg & ~std::byte(outSourceMask)) | std::byte(outSourceSrc);
+        ports_[p] = reg;
     }
+    std::span<std::byte const> regs{ regs_ };
+    std::span<std::byte const> ports{ ports_ };
+    return { regs.first(2), ports.first(1), regs.subspan(3, 1), ports.last(1), regs.subspan(5), txcs_, txu_ };
+}
+
+bool Src4392::restore(std::span<std::byte const> cfg) {
+    if (cfg.size() != configSize)
+        return false;
+    std::ranges::copy(cfg.first(regs_.size()), regs_.begin());
+    std::ranges::copy(cfg.subspan(regs_.size(), txcs_.size()), txcs_.begin());
+    std::ranges::copy(cfg.last(txu_.size()), txu_.begin());
+    return true;
+}
+
+void Src4392::writeOverrides(std::span<Override const> overrides) {
+    if (overrides.size() > maxOps - nops_) {
+        writeRegs();
+        return;
+    }
+    for (auto const &o : overrides)
+        rdwr(std::span(regs_).subspan(o.reg - 1, 1), o.reg, 0);
+}
+
+Src4392::Src4392(SRC4392::Intgr const &in, Handler *hdl)
+    : ops_{}
+    , pool_{}
+    , hdl_{hdl}
+    , nops_{0}
+    , nentries_{0}
+    , chipPage_{0}
+    , savedTransfers_{0}
+    , savedBytes_{0}
+    , bypassed_{0}
+    , ports_{}
 {
+    for (auto &e : pool_)
+        e.par = params(1U << in.addr);
 }
 
 std::byte *Src4392::getPtr(uint8_t addr, std::byte &page) {
@@ -66,22 +152,156 @@ std::byte *Src4392::getPtr(uint8_t addr, std::byte &page) {
     }
 }
 
-uint64_t Src4392::update(std::span<std::byte const> buf, std::span<std::byte> internal) {
-    size_t size = std::min(buf.size(), internal.size());
-    uint64_t res{0};
-    for (size_t i = 0; i < size; ++i) {
-        res |= uint64_t(buf[i] != internal[i]) << i;
-        internal[i] = buf[i];
+uint8_t Src4392::checkRxCS() const {
+    uint8_t bad = 0;
+    for (size_t sub = 0; sub < csStride; ++sub) {
+        auto *block = rxcs_.data() + sub;
+        if (aes3::isProfessional(block) && !aes3::check(block, csStride))
+            bad |= 1u << sub;
     }
-    return res;
+    return bad;
+}
+
+aes3::Summary Src4392::summarizeRxCS(unsigned sub) const {
+    return aes3::summarize(rxcs_.data() + sub, csStride);
+}
+
+aes3::MicStatus Src4392::summarizeRxMic() const {
+    return aes3::summarizeMic(rxcs_.data(), rxu_.data(), csStride);
 }
 
-void Src4392::rdwr(lpc865::SpiQueue &spiq, std::span<std::byte> buf, uint8_t reg) {
-    entry_.buf = buf.data();
-    entry_.size = buf.size();
-    entry_.par.cmd.read = reg >> 7;
-    entry_.par.cmd.ins = reg;
-    spiq.enqueue(entry_);
+bool Src4392::bypass(bool on) {
+    bool changed = false;
+    for (unsigned p = 0; p < std::size(portRegs); ++p) {
+        auto &reg = regs_[portRegs[p] - 1];
+        uint8_t source = uint8_t(reg) & uint8_t(outSourceMask);
+        if (on && source == outSourceSrc) {
+            reg = (reg & ~std::byte(outSourceMask)) | std::byte(outSourceDir);
+            bypassed_ |= 1u << p;
+            changed = true;
+        } else if (!on && (bypassed_ & (1u << p)) && source == outSourceDir) {
+            reg = (reg & ~std::byte(outSourceMask)) | std::byte(outSourceSrc);
+            changed = true;
+        }
+    }
+    if (!on)
+        bypassed_ = 0;
+    return changed;
+}
+
+void Src4392::sealTxCS() {
+    for (size_t sub = 0; sub < csStride; ++sub) {
+        auto *block = txcs_.data() + sub;
+        if (aes3::isProfessional(block))
+            aes3::seal(block, csStride);
+    }
+}
+
+void Src4392::rdwr(std::span<std::byte> buf, uint8_t reg, uint8_t page) {
+    assert(nops_ < maxOps);
+    ops_[nops_++] = { buf.data(), uint8_t(buf.size()), reg, page };
+}
+
+/** Group the operations by page, in the order the pages first occur, but
+ * starting with the page the chip is on. The sort is stable.
+ */
+void Src4392::order() {
+    uint8_t rank[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+    uint8_t next = 0;
+    rank[chipPage_] = next++;
+    for (unsigned i = 0; i < nops_; ++i)
+        if (rank[ops_[i].page] == 0xFF)
+            rank[ops_[i].page] = next++;
+    for (unsigned i = 1; i < nops_; ++i) {
+        Op op = ops_[i];
+        unsigned j = i;
+        for (; j > 0 && rank[ops_[j - 1].page] > rank[op.page]; --j)
+            ops_[j] = ops_[j - 1];
+        ops_[j] = op;
+    }
+}
+
+/** Merge reads of the same page into one transfer, where the registers are
+ * close enough, and the buffers are laid out like the registers. Writes are
+ * only merged where the registers are adjacent, so that no register gets
+ * written that wasn't meant to be.
+ *
+ * A gap is only bridged on pages 1 and 2. Their buffers hold nothing but the
+ * data of the chip, and reading them has no side effects. On page 0, a gap
+ * would overwrite cached registers that may hold a write still to be written
+ * back, and the status registers clear on read, so reads there are only
+ * merged where they are adjacent.
+ */
+void Src4392::merge() {
+    unsigned n = 0;
+    for (unsigned i = 0; i < nops_; ++i) {
+        Op const &op = ops_[i];
+        if (n > 0) {
+            Op &prev = ops_[n - 1];
+            unsigned first = prev.reg & 0x7F;
+            unsigned end = first + prev.size;
+            unsigned start = op.reg & 0x7F;
+            bool reads = prev.reg & op.reg & 0x80;
+            bool writes = !((prev.reg | op.reg) & 0x80);
+            unsigned gap = op.page == 0 ? 0 : maxGap;
+            if (prev.page == op.page && start >= end
+                && ((reads && start - end <= gap) || (writes && start == end))
+                && op.buf == prev.buf + (start - first)) {
+                prev.size = uint8_t(start + op.size - first);
+                ++savedTransfers_;
+                savedBytes_ += cmdBytes - int32_t(start - end);
+                continue;
+            }
+        }
+        ops_[n++] = op;
+    }
+    nops_ = n;
+}
+
+void Src4392::emit(std::byte *buf, size_t size, uint8_t reg) {
+    auto &e = pool_[nentries_++];
+    e.buf = buf;
+    e.size = size;
+    e.par.cmd.read = reg >> 7;
+    e.par.cmd.ins = reg;
+    e.hdl = nullptr;
+}
+
+void Src4392::submit(lpc865::SpiQueue &spiq, bool notify) {
+    if (nops_ == 0)
+        return;
+    // Page switches needed without optimization, i.e. in the order of the
+    // operations, starting from and returning to page 0.
+    int naive = 0;
+    uint8_t page = 0;
+    for (unsigned i = 0; i < nops_; ++i) {
+        if (ops_[i].page != page)
+            ++naive;
+        page = ops_[i].page;
+    }
+    if (page != 0)
+        ++naive;
+
+    order();
+    merge();
+    nentries_ = 0;
+    int switches = 0;
+    for (unsigned i = 0; i < nops_; ++i) {
+        Op const &op = ops_[i];
+        if (op.page != chipPage_) {
+            emit(&pageValues_[op.page], 1, pageReg);
+            chipPage_ = op.page;
+            ++switches;
+        }
+        emit(op.buf, op.size, op.reg);
+    }
+    savedTransfers_ += naive - switches;
+    savedBytes_ += (naive - switches) * (cmdBytes + 1);
+
+    pool_[nentries_ - 1].hdl = notify ? hdl_ : nullptr;
+    for (unsigned i = 0; i < nentries_; ++i)
+        spiq.enqueue(pool_[i]);
+    nops_ = 0;
 }
 
 } //!@} namespace
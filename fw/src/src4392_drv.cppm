@@ -10,106 +10,356 @@ module;
 #include <span>
 export module src4392_drv;
 import spi_queue;
+import spi_drv;
 import handler;
+import utility;
+import aes3;
 import SRC4392;
 
 export namespace src4392 {
 
+/** Bits of receiver status register 1 (0x13).
+ * Receiver interrupt mask register 1 (0x16) has the same layout.
+ */
+enum RxStatus1 : uint8_t {
+    rxBlockStart    = 0x01,     //!< RBTI: start of a channel status block
+    rxQChange       = 0x02,     //!< QCHG: Q-channel sub-code data has changed
+    rxUnlock        = 0x04,     //!< UNLOCK: the receiver PLL has lost lock
+    rxQCrc          = 0x08,     //!< QCRC: Q-channel sub-code CRC error
+};
+
+/** Bits of the non-PCM audio detection status register (0x12). */
+enum NonPcm : uint8_t {
+    npcmDtsCd       = 0x01,     //!< DTS CD/LD stream detected
+    npcmIec61937    = 0x02,     //!< IEC 61937 burst preamble detected
+};
+
+/** Bits of receiver status register 2 (0x14).
+ * Receiver interrupt mask register 2 (0x17) has the same layout.
+ */
+enum RxStatus2 : uint8_t {
+    rxCsCrc         = 0x01,     //!< CSCRC: channel status CRC error
+    rxParity        = 0x02,     //!< PARITY: parity error
+    rxValidity      = 0x04,     //!< VBIT: validity bit set
+    rxBiphase       = 0x08,     //!< BPERR: bi-phase coding error
+    rxSlip          = 0x10,     //!< OSLIP: output slip or repeat
+};
+
+/** A page 0 register whose initial value differs from the shared table. */
+struct Override {
+    uint8_t reg;                //!< Register address, 0x01..0x33
+    std::byte value;
+};
+
 /** SRC4392 driver class.
+ *
+ * The register access functions don't start a transfer right away. They add
+ * an operation to a batch, which submit() then enqueues on the SPI queue as a
+ * whole. Only the last operation of a batch calls the completion handler, so
+ * the SPI goes from one operation to the next without a handler round trip.
+ * The operations take their SPI queue entries from a small pool, which is
+ * free again once the completion handler has been called. A new batch must
+ * not be started before that.
+ *
+ * Each operation declares the page it addresses, and the driver keeps track
+ * of the page the chip is on. When a batch is submitted, it is optimized:
+ * - The operations are grouped by page, starting with the current page, as
+ *   operations within a batch must not depend on each other's order.
+ * - Page register writes are only inserted where the page changes. The chip
+ *   stays on the last page, instead of returning to page 0.
+ * - Reads of the same page whose register ranges are adjacent, or on pages
+ *   1 and 2 separated by a small gap, are merged into one auto-increment
+ *   transfer, provided their buffers are laid out like the registers. Page 0
+ *   gaps aren't bridged, as they hold cached writes and clear-on-read status.
+ * - Writes of adjacent registers are merged in the same way, without a gap.
+ * The transfers and bytes saved are counted against issuing each operation
+ * on its own, bracketed by page switches from and back to page 0.
+ *
+ * The initial register values are mostly the same for all chips. They are
+ * kept in flash as one shared table, plus a few overrides per chip. The shared
+ * table is written to all chips at once by broadcast(), with several chip
+ * selects active, and straight from flash. Each chip then only needs its
+ * overrides written, see writeOverrides().
  */
 class Src4392 {
 public:
+    /** Fastest SPI clock of the control port, as a maxHz code. */
+    static constexpr auto maxSpeed = lpc865::Spi::mHz33;
+
     Src4392(SRC4392::Intgr const &in, Handler *hdl);
 
+    /** Write the same page 0 register data to several chips at once.
+     * @param spiq SPI queue
+     * @param entries Queue entries, untouched until the completion handler is called
+     * @param regs Values of addresses 0x01..0x33, which may be in flash
+     * @param all Chip selects that are set to page 0
+     * @param sel Chip selects that get regs, a subset of all, may be 0
+     * @param hdl Completion handler
+     *
+     * The SRC4392 only drives CDOUT while it is being read, so writes may
+     * select several chips at a time. The SPI only reads the data of a write,
+     * so the DMA can take it from flash.
+     */
+    static void broadcast(lpc865::SpiQueue &spiq, std::span<lpc865::SpiQueue::Entry, 2> entries,
+                          std::span<std::byte const> regs, uint8_t all, uint8_t sel, Handler *hdl);
+
+    /** Initialize the register cache.
+     * @param base Shared values of page 0 addresses 0x01..0x33
+     * @param overrides Values of this chip that differ from base
+     */
+    void initRegs(std::span<std::byte const> base, std::span<Override const> overrides);
+
+    /** Size of the configuration, as returned by config(). */
+    static constexpr size_t configSize = 51 + 48 + 48;
+
+    /** Number of parts of the configuration returned by config(). */
+    static constexpr size_t configParts = 7;
+
+    /** Get the configuration set by the host, i.e. the cached page 0
+     * registers, and the transmit channel status and user data of page 2.
+     * The parts are in the order of the registers. The output port registers
+     * are returned as the host set them, with a bypass() undone, as the
+     * bypass follows the received stream and isn't part of the configuration.
+     */
+    std::array<std::span<std::byte const>, configParts> config();
+
+    /** Replace the cached configuration with one saved from config().
+     * @return False if the size doesn't match
+     */
+    bool restore(std::span<std::byte const> cfg);
+
+    /** The chip has been set to page 0, by a broadcast or by a reset. */
+    void resetPage() { chipPage_ = 0; }
+
     /** Update the registers.
      * @param buf Buffer containing new register data.
+     * @param changed Optional bitmap receiving a bit for each changed byte
      *
-     * The new data is compared with the old data to determine the change mask.
-     * The new data then replaces the old. Finally the change mask is returned.
+     * The new data is compared with the old data to determine the changed
+     * bytes. The new data then replaces the old. Finally the range of changed
+     * bytes is returned.
      */
-    uint64_t updateRegs(std::span<std::byte const> buf) {
-        return update(buf, regs_);
+    Diff updateRegs(std::span<std::byte const> buf, std::span<uint32_t> changed = {}) {
+        return diffCopy(regs_, buf, changed);
     }
 
     /** Update the control/status data.
      * @param buf Buffer containing new data.
+     * @param changed Optional bitmap receiving a bit for each changed byte
      *
-     * The new data is compared with the old data to determine the change mask.
-     * The new data then replaces the old. Finally the change mask is returned.
+     * The new data is compared with the old data to determine the changed
+     * bytes. The new data then replaces the old. Finally the range of changed
+     * bytes is returned.
      */
-    uint64_t updateCS(std::span<std::byte const> buf) {
-        return update(buf, rxcs_);
+    Diff updateCS(std::span<std::byte const> buf, std::span<uint32_t> changed = {}) {
+        return diffCopy(rxcs_, buf, changed);
     }
 
     /** Update the user data.
      * @param buf Buffer containing new data.
+     * @param changed Optional bitmap receiving a bit for each changed byte
      *
-     * The new data is compared with the old data to determine the change mask.
-     * The new data then replaces the old. Finally the change mask is returned.
+     * The new data is compared with the old data to determine the changed
+     * bytes. The new data then replaces the old. Finally the range of changed
+     * bytes is returned.
      */
-    uint64_t updateU(std::span<std::byte const> buf) {
-        return update(buf, rxu_);
+    Diff updateU(std::span<std::byte const> buf, std::span<uint32_t> changed = {}) {
+        return diffCopy(rxu_, buf, changed);
     }
 
-    void switchPage(lpc865::SpiQueue &spiq, uint8_t page) {
-        page_ = std::byte(page);
-        rdwr(spiq, { &page_, 1 }, 0x7F);
+    void writeRegs() {
+        rdwr(regs_, 0x01, 0);
     }
 
-    void writeRegs(lpc865::SpiQueue &spiq) {
-        rdwr(spiq, regs_, 0x01);
+    /** Write the registers that differ from the shared table.
+     * Too many of them for a batch are written as a whole page.
+     */
+    void writeOverrides(std::span<Override const> overrides);
+
+    void writeCS() {
+        rdwr(txcs_, 0x00, 2);
     }
 
-    void writeCS(lpc865::SpiQueue &spiq) {
-        rdwr(spiq, txcs_, 0x00);
+    void writeU() {
+        rdwr(txu_, 0x40, 2);
     }
 
-    void writeU(lpc865::SpiQueue &spiq) {
-        rdwr(spiq, txu_, 0x40);
+    void readRegs() {
+        rdwr(regs_, 0x81, 0);
     }
 
-    void readRegs(lpc865::SpiQueue &spiq) {
-        rdwr(spiq, regs_, 0x81);
+    void readTxStatus() {
+        rdwr(std::span(regs_).subspan(9,1), 0x8A, 0);
     }
 
-    void readTxStatus(lpc865::SpiQueue &spiq) {
-        rdwr(spiq, std::span(regs_).subspan(9,1), 0x8A);
+    void readRatio() {
+        rdwr(std::span(regs_).subspan(49,2), 0xB2, 0);
     }
 
-    void readRatio(lpc865::SpiQueue &spiq) {
-        rdwr(spiq, std::span(regs_).subspan(49,2), 0xB2);
+    /** Read the receiver status registers 0x12..0x15.
+     * Reading clears the latched status bits, and with them the interrupt.
+     */
+    void readRxStatus() {
+        rdwr(std::span(regs_).subspan(17,4), 0x92, 0);
     }
 
-    void readRxStatus(lpc865::SpiQueue &spiq) {
-        rdwr(spiq, std::span(regs_).subspan(17,4), 0x92);
+    /** Receiver status register 1 as of the last readRxStatus(), see RxStatus1. */
+    uint8_t rxStatus1() const { return uint8_t(regs_[0x13 - 1]); }
+
+    /** Receiver status register 2 as of the last readRxStatus(), see RxStatus2. */
+    uint8_t rxStatus2() const { return uint8_t(regs_[0x14 - 1]); }
+
+    /** Non-PCM audio detection status as of the last readRxStatus(), see NonPcm. */
+    uint8_t nonPcm() const { return uint8_t(regs_[0x12 - 1]); }
+
+    /** Burst preamble Pc as of the last readSubchannel(). */
+    uint16_t burstPc() const { return uint16_t(regs_[0x29 - 1]) << 8 | uint16_t(regs_[0x2A - 1]); }
+
+    /** Burst preamble Pd as of the last readSubchannel(). */
+    uint16_t burstPd() const { return uint16_t(regs_[0x2B - 1]) << 8 | uint16_t(regs_[0x2C - 1]); }
+
+    /** SRC ratio readback as of the last readRatio(), 0x32 in the high byte. */
+    uint16_t ratio() const { return uint16_t(regs_[0x32 - 1]) << 8 | uint16_t(regs_[0x33 - 1]); }
+
+    /** Route the audio ports that output the SRC to the DIR instead, or back.
+     * @param on True to bypass the SRC, false to undo an earlier bypass
+     * @return True if a port control register has changed, so that page 0
+     *         needs writing back
+     *
+     * Only ports that were switched by an earlier call are switched back, so
+     * that the host's choice of the output source is preserved otherwise.
+     */
+    bool bypass(bool on);
+
+    void readSubchannel() {
+        rdwr(std::span(regs_).subspan(30,14), 0x9F, 0);
+    }
+
+    /** Read the received channel status into the staging buffer.
+     * Call commitCS() upon completion. Together with readU(), this becomes a
+     * single transfer.
+     */
+    void readCS() {
+        rdwr(stagingCS(), 0x80, 1);
     }
 
-    void readSubchannel(lpc865::SpiQueue &spiq) {
-        rdwr(spiq, std::span(regs_).subspan(30,14), 0x9F);
+    /** Read the received user data into the staging buffer.
+     * Call commitU() upon completion.
+     */
+    void readU() {
+        rdwr(stagingU(), 0xC0, 1);
     }
 
-    void readCS(lpc865::SpiQueue &spiq) {
-        rdwr(spiq, rxcs_, 0x80);
+    /** True if operations have been added since the last submit(). */
+    bool pending() const { return nops_ != 0; }
+
+    /** Enqueue the operations added since the last call.
+     * @param notify False to leave out the completion handler, when the batch
+     *        is followed by one of another chip that completes the chain
+     *
+     * The completion handler is called when the last of them has completed.
+     */
+    void submit(lpc865::SpiQueue &spiq, bool notify = true);
+
+    /** Update the cached channel status from the staging buffer.
+     * @param changed Optional bitmap receiving a bit for each changed byte
+     * @return The range of changed bytes
+     */
+    Diff commitCS(std::span<uint32_t> changed = {}) {
+        return diffCopy(rxcs_, stagingCS(), changed);
     }
 
-    void readU(lpc865::SpiQueue &spiq) {
-        rdwr(spiq, rxu_, 0xC0);
+    /** Update the cached user data from the staging buffer.
+     * @param changed Optional bitmap receiving a bit for each changed byte
+     * @return The range of changed bytes
+     */
+    Diff commitU(std::span<uint32_t> changed = {}) {
+        return diffCopy(rxu_, stagingU(), changed);
     }
 
+    /** Decode the commonly needed fields of the received channel status of a subchannel.
+     * @param sub Subchannel (0: A, 1: B)
+     */
+    aes3::Summary summarizeRxCS(unsigned sub) const;
+
+    /** Decode the AES42 microphone status from the received user data of
+     * subchannel A.
+     */
+    aes3::MicStatus summarizeRxMic() const;
+
     std::byte *getPtr(uint8_t addr, std::byte &page);
 
+    /** Check the CRCC of the received channel status.
+     * @return Bitmap of the subchannels in professional format whose CRCC
+     *         doesn't match (bit 0: A, bit 1: B)
+     */
+    uint8_t checkRxCS() const;
+
+    /** Insert the CRCC into the transmit channel status.
+     * This is done for each subchannel in professional format.
+     */
+    void sealTxCS();
+
+    /** Number of transfers saved by the batch optimization. This wraps around. */
+    uint16_t savedTransfers() const { return savedTransfers_; }
+
+    /** Number of bytes saved by the batch optimization. Merging reads across
+     * a gap costs bytes, so this may be negative.
+     */
+    int32_t savedBytes() const { return savedBytes_; }
+
 private:
-    static uint64_t update(std::span<std::byte const>, std::span<std::byte>);
+    static constexpr unsigned maxOps = 6;      //!< Maximum number of operations in a batch
+    static constexpr unsigned poolSize = maxOps + 3;   //!< Entries for the operations and page switches
+    static constexpr unsigned maxGap = 16;     //!< Largest gap in bytes bridged by merging reads
 
-    void rdwr(lpc865::SpiQueue &, std::span<std::byte>, uint8_t);
+    /** An operation of a batch. */
+    struct Op {
+        std::byte *buf;
+        uint8_t size;
+        uint8_t reg;                    //!< Register address, MSB set for reads
+        uint8_t page;
+    };
 
-    lpc865::SpiQueue::Entry entry_;
-    std::byte page_;                    //!< Page register at 0x7F
-    std::array<std::byte, 51> regs_;    //!< Page 0 addresses 0x01..0x33
-    std::array<std::byte, 48> rxcs_;    //!< Page 1 addresses 0x00..0x2F
-    std::array<std::byte, 48> rxu_;     //!< Page 1 addresses 0x40..0x6F
-    std::array<std::byte, 48> txcs_;    //!< Page 2 addresses 0x00..0x2F
-    std::array<std::byte, 48> txu_;     //!< Page 2 addresses 0x40..0x6F
+    void rdwr(std::span<std::byte>, uint8_t, uint8_t page);
+    void order();
+    void merge();
+    void emit(std::byte *buf, size_t size, uint8_t reg);
+
+    static lpc865::Spi::Parameters params(uint8_t sel);
+
+    std::span<std::byte> stagingCS() { return std::span(staging_).first(0x30); }
+    std::span<std::byte> stagingU() { return std::span(staging_).subspan(0x40, 0x30); }
+
+    std::array<Op, maxOps> ops_;
+    std::array<lpc865::SpiQueue::Entry, poolSize> pool_;
+    Handler *hdl_;                      //!< Completion handler of a batch
+    uint8_t nops_;                      //!< Operations in the current batch
+    uint8_t nentries_;                  //!< Entries used by the current batch
+    uint8_t chipPage_;                  //!< Page the chip is on after the submitted batches
+    uint16_t savedTransfers_;
+    int32_t savedBytes_;
+    uint8_t bypassed_;                  //!< Ports switched from the SRC to the DIR by bypass()
+    std::array<std::byte, 2> ports_;    //!< Output port registers as saved by config()
+    // The buffers are word aligned for diffCopy()
+    alignas(4) std::array<std::byte, 51> regs_;     //!< Page 0 addresses 0x01..0x33
+    alignas(4) std::array<std::byte, 48> rxcs_;     //!< Page 1 addresses 0x00..0x2F
+    alignas(4) std::array<std::byte, 48> rxu_;      //!< Page 1 addresses 0x40..0x6F
+    alignas(4) std::array<std::byte, 48> txcs_;     //!< Page 2 addresses 0x00..0x2F
+    alignas(4) std::array<std::byte, 48> txu_;      //!< Page 2 addresses 0x40..0x6F
+
+    /** Buffer for reading received data from the chip, before it is compared
+     * with the cache. It mirrors page 1 addresses 0x00..0x6F, so that the
+     * channel status and user data reads can be merged. Each chip has its
+     * own, since the reads of several chips may be chained before any of
+     * them is committed.
+     */
+    alignas(4) std::array<std::byte, 0x70> staging_;
+
+    /** Values written to the page register. A batch may switch pages more
+     * than once, so each switch needs its own source byte.
+     */
+    static std::array<std::byte, 4> pageValues_;
 };
 
 } //!@} namespace
@@ -0,0 +1,88 @@
+/** @file
+ * Initial register values of the SRC4392 chips.
+ *
+ * They are shared by the firmware and the host build, which checks the
+ * interrupt setup against a model of the chip.
+ *
+ * @addtogroup SRC4392
+ * @{
+ */
+
+module;
+#include <cstddef>
+export module src4392_init;
+import src4392_drv;
+
+constexpr std::byte operator""_y(unsigned long long value) {
+    return static_cast<std::byte>(value);
+}
+
+export namespace src4392 {
+
+/** Initial values of page 0 addresses 0x01..0x33, shared by all channels.
+ * They stay in flash, the broadcast to the chips is fed from here.
+ */
+inline constexpr std::byte initBase[] = {
+    0x3F_y, // Register 01: Power-Down and Reset
+    0x00_y, // Register 02: Global Interrupt Status (Read-Only)
+    0x31_y, // Register 03: Port A Control Register 1
+    0x00_y, // Register 04: Port A Control Register 2
+    0x31_y, // Register 05: Port B Control Register 1
+    0x00_y, // Register 06: Port B Control Register 2
+    0x79_y, // Register 07: Transmitter Control Register 1
+    0x20_y, // Register 08: Transmitter Control Register 2
+    0x01_y, // Register 09: Transmitter Control Register 3
+    0x00_y, // Register 0A: SRC and DIT Status (Read-Only)
+    0x00_y, // Register 0B: SRC and DIT Interrupt Mask Register
+    0x00_y, // Register 0C: SRC and DIT Interrupt Mode Register
+    0x08_y, // Register 0D: Receiver Control Register 1
+    0x00_y, // Register 0E: Receiver Control Register 2
+    0x22_y, // Register 0F: Receiver PLL1 Configuration Register 1
+    0x00_y, // Register 10: Receiver PLL1 Configuration Register 2
+    0x00_y, // Register 11: Receiver PLL1 Configuration Register 3
+    0x00_y, // Register 12: Non-PCM Audio Detection Status Register (Read-Only)
+    0x00_y, // Register 13: Receiver Status Register 1 (Read-Only)
+    0x00_y, // Register 14: Receiver Status Register 2 (Read-Only)
+    0x00_y, // Register 15: Receiver Status Register 3 (Read-Only)
+    0x07_y, // Register 16: Receiver Interrupt Mask Register 1 (block start, Q-subcode change, unlock)
+    0x1E_y, // Register 17: Receiver Interrupt Mask Register 2 (parity, validity, bi-phase, slip)
+    0x0A_y, // Register 18: Receiver Interrupt Mode Register 1 (block start, Q-subcode change level, others rising edge)
+    0x00_y, // Register 19: Receiver Interrupt Mode Register 2 (rising edge)
+    0x00_y, // Register 1A: Receiver Interrupt Mode Register 3 (rising edge)
+    0x01_y, // Register 1B: General-Purpose Output 1 (GPO1) Control Register
+    0x00_y, // Register 1C: General-Purpose Output 2 (GPO2) Control Register
+    0x0E_y, // Register 1D: General-Purpose Output 3 (GPO3) Control Register
+    0x09_y, // Register 1E: General-Purpose Output 4 (GPO4) Control Register
+    0x00_y, // Register 1F: Q-Channel Sub-Code Data Register 1 (Read-Only), Bits[7:0], Control and Address
+    0x00_y, // Register 20: Q-Channel Sub-Code Data Register 2 (Read-Only), Bits[15:8], Track
+    0x00_y, // Register 21: Q-Channel Sub-Code Data Register 3 (Read-Only), Bits[23:16], Index
+    0x00_y, // Register 22: Q-Channel Sub-Code Data Register 4 (Read-Only), Bits[31:24], Minutes
+    0x00_y, // Register 23: Q-Channel Sub-Code Data Register 5 (Read-Only), Bits[39:32], Seconds
+    0x00_y, // Register 24: Q-Channel Sub-Code Data Register 6 (Read-Only), Bits[47:40], Frame
+    0x00_y, // Register 25: Q-Channel Sub-Code Data Register 7 (Read-Only), Bits[55:48], Zero
+    0x00_y, // Register 26: Q-Channel Sub-Code Data Register 8 (Read-Only), Bits[63:56], AMIN
+    0x00_y, // Register 27: Q-Channel Sub-Code Data Register 9 (Read-Only), Bits[71:64], ASEC
+    0x00_y, // Register 28: Q-Channel Sub-Code Data Register 10 (Read-Only), Bits[79:72], AFRAME
+    0x00_y, // Register 29: Burst Preamble PC High-Byte Status Register (Read-Only)
+    0x00_y, // Register 2A: Burst Preamble PC Low-Byte Status Register (Read-Only)
+    0x00_y, // Register 2B: Burst Preamble PD High-Byte Status Register (Read-Only)
+    0x00_y, // Register 2C: Burst Preamble PD Low-Byte Status Register (Read-Only)
+    0x02_y, // Register 2D: SRC Control Register 1
+    0x00_y, // Register 2E: SRC Control Register 2
+    0x00_y, // Register 2F: SRC Control Register 3
+    0x00_y, // Register 30: SRC Control Register 4
+    0x00_y, // Register 31: SRC Control Register 5
+    0x00_y, // Register 32: SRC Ratio Readback Register (Read-Only)
+    0x00_y, // Register 33: SRC Ratio Readback Register (Read-Only)
+};
+
+/** Initial values of channel A that differ from initBase, in its port A and
+ * transmitter settings.
+ */
+inline constexpr Override initChannelA[] = {
+    { 0x03, 0x39_y },       // Port A Control Register 1
+    { 0x04, 0x03_y },       // Port A Control Register 2
+    { 0x07, 0x7D_y },       // Transmitter Control Register 1
+};
+
+} //!@} namespace
@@ -59,6 +59,8 @@ inline int sysinit() {
     syscon.FCLKSEL[5] = FCLKSEL{ .SEL=FCLKSEL_::FRO };      // I2C0 clock == 60 MHz
     syscon.FCLKSEL2[0] = FCLKSEL2{ .SEL=FCLKSEL2_::FRO };   // SPI0 clock == 60 MHz
     syscon.FCLKSEL2[1] = FCLKSEL2{ .SEL=FCLKSEL2_::FRO };   // SPI1 clock == 60 MHz
+    syscon.ADCCLKSEL = ADCCLKSEL{ .SEL=ADCCLKSEL_::FRO };
+    syscon.ADCCLKDIV = ADCCLKDIV{ .DIV=2 };         // ADC clock == 30 MHz
     syscon.PINTSEL[0] = PINTSEL{ .INTPIN = 19 };    // INTA
     syscon.PINTSEL[1] = PINTSEL{ .INTPIN = 20 };    // INTB
     syscon.PINTSEL[2] = PINTSEL{ .INTPIN = 37 };    // INTC
@@ -124,6 +126,12 @@ inline int sysinit() {
     swm0.PINENABLE0.set(0xFFFF081F);        // enable ADC0..3, CLKIN, XTALIN, RESET and SWD
 
     auto &inputmux = *i_INPUTMUX.registers; // INPUTMUX register set
+    inputmux.DMA_ITRIG_INMUX[15].set(0);    // DMA channel 15 trigger: ADC0 sequence A
+    inputmux.DMA_ITRIG_INMUX[0].set(2);     // DMA channel 0 trigger: FTM0 channel 0 (BLS)
+    inputmux.DMA_ITRIG_INMUX[1].set(4);     // DMA channel 1 trigger: FTM0 channel 2 (INTA)
+    inputmux.DMA_ITRIG_INMUX[2].set(5);     // DMA channel 2 trigger: FTM0 channel 3 (INTB)
+    inputmux.DMA_ITRIG_INMUX[3].set(6);     // DMA channel 3 trigger: FTM0 channel 4 (INTC)
+    inputmux.DMA_ITRIG_INMUX[4].set(7);     // DMA channel 4 trigger: FTM0 channel 5 (INTD)
 
     return 0;
 }
@@ -141,10 +149,11 @@ void _fini(void) {}
 
 /** Reset entry point.
  * Sets up a simple runtime environment and initializes the C/C++ library.
+ * Functions in the .ramfunc section are only available after startup_meminit().
  */
 void ResetISR(void) {
     sysinit();              // early system initialization to make memory usable
-    startup_meminit();      // initialize .data and .bss
+    startup_meminit();      // initialize .data, .ramfunc and .bss
     __libc_init_array();    // C++ library initialization
     _exit(main());          // _exit() never returns
 }
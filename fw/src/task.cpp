@@ -0,0 +1,56 @@
+/** @file
+ * C++20 coroutine tasks with statically allocated frames
+ * @addtogroup Channel
+ * @ingroup AES42HAT
+ * @{
+ */
+module;
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+module task;
+
+namespace {
+
+// The frame size must hold the largest task, which depends on its locals and
+// the awaiters it uses. PoolStats::largest shows the actual need.
+constexpr size_t frameSize = 128;
+constexpr size_t frameCount = 6;
+
+alignas(8) std::byte frames[frameCount][frameSize];
+uint8_t used[frameCount];
+task::PoolStats stats{ frameSize, frameCount, 0, 0, 0 };
+
+} // namespace
+
+std::span<std::byte> task::poolStats() {
+    return std::as_writable_bytes(std::span(&stats, 1));
+}
+
+void *task::allocFrame(size_t size) noexcept {
+    stats.largest = uint16_t(std::max<size_t>(stats.largest, size));
+    if (size <= frameSize) {
+        for (size_t i = 0; i < frameCount; ++i) {
+            if (!used[i]) {
+                used[i] = 1;
+                ++stats.inUse;
+                return frames[i];
+            }
+        }
+    }
+    ++stats.failures;
+    return nullptr;
+}
+
+void task::freeFrame(void *frame) noexcept {
+    for (size_t i = 0; i < frameCount; ++i) {
+        if (frame == frames[i]) {
+            used[i] = 0;
+            --stats.inUse;
+            return;
+        }
+    }
+}
+
+/** @}*/
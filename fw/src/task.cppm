@@ -0,0 +1,195 @@
+/** @file
+ * C++20 coroutine tasks with statically allocated frames
+ *
+ * @addtogroup Channel
+ * @ingroup AES42HAT
+ * @{
+ */
+
+module;
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+export module task;
+import handler;
+import spi_queue;
+import wkt_drv;
+
+export namespace task {
+
+/** Frame pool statistics. */
+struct PoolStats {
+    uint16_t frameSize;     //!< Size of each frame in bytes
+    uint8_t frames;         //!< Number of frames in the pool
+    uint8_t inUse;          //!< Frames currently allocated
+    uint16_t largest;       //!< Largest frame size requested so far
+    uint16_t failures;      //!< Requests that found no suitable frame
+};
+
+/** Get the frame pool statistics, for exposing them to the host. */
+std::span<std::byte> poolStats();
+
+/** Allocate a coroutine frame from the static pool.
+ * @return The frame, or nullptr if the size exceeds the frame size, or all
+ *         frames are in use
+ */
+void *allocFrame(size_t size) noexcept;
+
+/** Return a coroutine frame to the static pool. */
+void freeFrame(void *frame) noexcept;
+
+/** Coroutine task.
+ *
+ * Unlike the CORO_REENTER/CORO_YIELD coroutines, a task keeps its local
+ * variables across suspension points, can call other tasks with co_await, and
+ * can wait for SPI transfers and timers through the awaitables below. Its
+ * frame comes from a pool of fixed size frames, which is dimensioned at
+ * compile time, so there is no heap. If no frame is available, the task is
+ * empty, which the caller must check with valid().
+ *
+ * A task starts suspended. The owner starts it with start(), and keeps the
+ * Task object until done() is true, as destroying it destroys the frame. A
+ * task that is awaited by another task is started by the co_await, and
+ * resumes the awaiting task when it finishes.
+ */
+class [[nodiscard]] Task {
+public:
+    struct promise_type {
+        static void *operator new(size_t size) noexcept { return allocFrame(size); }
+        static void operator delete(void *frame) noexcept { freeFrame(frame); }
+        static Task get_return_object_on_allocation_failure() noexcept { return Task{}; }
+
+        Task get_return_object() noexcept {
+            return Task{ std::coroutine_handle<promise_type>::from_promise(*this) };
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        /** Transfers control to the awaiting task, if any. */
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                if (auto c = h.promise().continuation_)
+                    return c;
+                return std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {}
+
+        std::coroutine_handle<> continuation_;
+    };
+
+    Task() =default;
+    Task(Task &&other) noexcept : h_{std::exchange(other.h_, {})} {}
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            if (h_)
+                h_.destroy();
+            h_ = std::exchange(other.h_, {});
+        }
+        return *this;
+    }
+    ~Task() {
+        if (h_)
+            h_.destroy();
+    }
+
+    /** True if the task got a frame. */
+    bool valid() const { return bool(h_); }
+
+    /** True if the task has run to its end. */
+    bool done() const { return !h_ || h_.done(); }
+
+    /** Run the task up to its first suspension. */
+    void start() {
+        if (h_ && !h_.done())
+            h_.resume();
+    }
+
+    /** Awaiting a task runs it, and resumes the awaiting task when it ends. */
+    auto operator co_await() noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> h;
+            bool await_ready() noexcept { return !h || h.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> c) noexcept {
+                h.promise().continuation_ = c;
+                return h;
+            }
+            void await_resume() noexcept {}
+        };
+        return Awaiter{ h_ };
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : h_{h} {}
+
+    std::coroutine_handle<promise_type> h_;
+};
+
+/** Handler that resumes a suspended task.
+ * The awaitables hand it to the driver as the completion handler. It is
+ * owned by the object that runs the task, and can serve one suspension at a
+ * time.
+ */
+class Resumer : public Handler {
+public:
+    Resumer() =default;
+    explicit Resumer(ReadySet) : Handler{readySet} {}
+
+    void act() override {
+        if (auto h = std::exchange(waiting_, {}))
+            h.resume();
+    }
+
+    std::coroutine_handle<> waiting_;
+};
+
+/** Awaitable for an SPI transfer.
+ * @param spiq The SPI queue
+ * @param e The entry, whose completion handler is replaced
+ * @param r The resumer of the awaiting task
+ */
+inline auto transfer(lpc865::SpiQueue &spiq, lpc865::SpiQueue::Entry &e, Resumer &r) {
+    struct Awaiter {
+        lpc865::SpiQueue &spiq;
+        lpc865::SpiQueue::Entry &e;
+        Resumer &r;
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) noexcept {
+            r.waiting_ = h;
+            e.hdl = &r;
+            spiq.enqueue(e);
+        }
+        void await_resume() noexcept {}
+    };
+    return Awaiter{ spiq, e, r };
+}
+
+/** Awaitable for a WKT delay.
+ * @param wkt The wakeup timer, which must not be in use otherwise
+ * @param count Delay in WKT clock cycles
+ * @param r The resumer of the awaiting task, which should use the ready set
+ */
+inline auto sleep(lpc865::Wkt &wkt, uint32_t count, Resumer &r) {
+    struct Awaiter {
+        lpc865::Wkt &wkt;
+        uint32_t count;
+        Resumer &r;
+        bool await_ready() noexcept { return count == 0; }
+        void await_suspend(std::coroutine_handle<> h) noexcept {
+            r.waiting_ = h;
+            wkt.start(count, r);
+        }
+        void await_resume() noexcept {}
+    };
+    return Awaiter{ wkt, count, r };
+}
+
+} // namespace
+
+//!@}
@@ -0,0 +1,86 @@
+/** @file
+ * Software timers
+ * @addtogroup Channel
+ * @ingroup AES42HAT
+ * @{
+ */
+module;
+#include <cstddef>
+#include <cstdint>
+module timer;
+
+static constexpr uint32_t slotMask = TimerWheel::slots - 1;
+
+void TimerWheel::arm(Timer &t, uint32_t ticks) {
+    t.unlink();
+    t.expiry_ = now_ + (ticks ? ticks : 1);
+    insert(t);
+}
+
+/** Put an unlinked timer into the slot for its expiry. */
+void TimerWheel::insert(Timer &t) {
+    uint32_t delta = t.expiry_ - now_;
+    TimerLink *slot;
+    if (delta < slots)
+        slot = &wheel_[0][t.expiry_ & slotMask];
+    else if (delta < slots * slots)
+        slot = &wheel_[1][(t.expiry_ >> slotBits) & slotMask];
+    else    // park it in the slot that cascades last
+        slot = &wheel_[1][((now_ >> slotBits) - 1) & slotMask];
+    t.linkBefore(*slot);
+}
+
+void TimerWheel::tick() {
+    ++now_;
+    if ((now_ & slotMask) == 0) {
+        // Move the timers of the level 1 slot out of the way first, as
+        // parked timers may go back into the same slot.
+        TimerLink cascade;
+        auto &from = wheel_[1][(now_ >> slotBits) & slotMask];
+        if (from.linked()) {
+            cascade.linkBefore(from);
+            from.unlink();
+        }
+        while (cascade.linked()) {
+            auto &t = static_cast<Timer &>(*cascade.next_);
+            t.unlink();
+            insert(t);
+        }
+    }
+    auto &slot = wheel_[0][now_ & slotMask];
+    while (slot.linked()) {
+        auto &t = static_cast<Timer &>(*slot.next_);
+        t.unlink();
+        if (t.period_) {
+            t.expiry_ += t.period_;
+            insert(t);
+        }
+        t.hdl_.post();
+    }
+}
+
+void TimerWheel::act() {
+    uint32_t ticks = mrt_.ticks(chan_);
+    while (done_ != ticks) {
+        ++done_;
+        tick();
+    }
+}
+
+void TimerWheel::start(unsigned chan, uint32_t interval) {
+    chan_ = uint8_t(chan);
+    done_ = 0;
+    mrt_.startRepeat(chan, interval, *this);
+}
+
+TimerWheel::TimerWheel(lpc865::Mrt &mrt)
+    : Handler{readySet}
+    , mrt_{mrt}
+    , now_{0}
+    , done_{0}
+    , chan_{0}
+    , wheel_{}
+{
+}
+
+/** @}*/
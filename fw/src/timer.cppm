@@ -0,0 +1,128 @@
+/** @file
+ * Software timers
+ *
+ * @addtogroup Channel
+ * @ingroup AES42HAT
+ * @{
+ */
+
+module;
+#include <cstddef>
+#include <cstdint>
+export module timer;
+import handler;
+import mrt_drv;
+
+/** Link of a timer in a slot of the timer wheel.
+ * The slots are rings with the slot itself as the head node, like StackRing,
+ * but doubly linked, so that a timer can be removed without a search.
+ */
+export struct TimerLink {
+    TimerLink *next_;
+    TimerLink *prev_;
+
+    constexpr TimerLink() : next_{this}, prev_{this} {}
+    TimerLink(TimerLink const &) =delete;
+    TimerLink &operator=(TimerLink const &) =delete;
+
+    bool linked() const { return next_ != this; }
+
+    void unlink() {
+        next_->prev_ = prev_;
+        prev_->next_ = next_;
+        next_ = prev_ = this;
+    }
+
+    void linkBefore(TimerLink &pos) {
+        next_ = &pos;
+        prev_ = pos.prev_;
+        pos.prev_->next_ = this;
+        pos.prev_ = this;
+    }
+};
+
+/** Software timer.
+ * When it expires, its handler is posted. A periodic timer is then armed
+ * again, relative to the time it should have expired, so that it doesn't
+ * accumulate the latency of the handler dispatch. The timer object is owned
+ * by the user, so the wheel needs no allocation.
+ */
+export class Timer : public TimerLink {
+public:
+    /** Create a timer.
+     * @param hdl Handler to post on expiry
+     * @param period Period in ticks for a periodic timer, or 0 for a one-shot
+     */
+    explicit Timer(Handler &hdl, uint32_t period = 0)
+        : hdl_{hdl}
+        , period_{period}
+        , expiry_{0}
+    {}
+
+    bool armed() const { return linked(); }
+
+private:
+    friend class TimerWheel;
+
+    Handler &hdl_;
+    uint32_t period_;
+    uint32_t expiry_;       //!< Tick number of the expiry
+};
+
+/** Hierarchical timer wheel.
+ *
+ * The wheel has two levels of 32 slots. Level 0 holds the timers that expire
+ * within the next 32 ticks, in the slot given by the low bits of the expiry.
+ * Level 1 holds the timers that expire later, in the slot given by the next 5
+ * bits. Whenever the low bits of the time wrap around, the timers of the next
+ * level 1 slot are cascaded into level 0. Timers beyond the range of level 1
+ * are parked in the level 1 slot that is cascaded last, and placed again from
+ * there. Arming and cancelling are thus O(1), and a tick only touches the
+ * timers that expire or cascade.
+ *
+ * The tick comes from a repeating MRT channel, which posts the wheel. As the
+ * MRT counts its expiries, ticks that pass while the wheel waits for dispatch
+ * aren't lost, they are processed in a row.
+ *
+ * All functions must be called from handlers, not from interrupt context.
+ */
+export class TimerWheel : public Handler {
+public:
+    static constexpr unsigned slotBits = 5;
+    static constexpr unsigned slots = 1u << slotBits;  //!< Slots per level
+    static constexpr unsigned levels = 2;
+
+    /** Arm a timer, or re-arm it if it is armed already.
+     * @param t The timer
+     * @param ticks Ticks until expiry, at least 1
+     */
+    void arm(Timer &t, uint32_t ticks);
+
+    /** Disarm a timer. Nothing happens if it isn't armed. */
+    void cancel(Timer &t) { t.unlink(); }
+
+    /** Current time in ticks. This wraps around. */
+    uint32_t now() const { return now_; }
+
+    /** Start ticking.
+     * @param chan MRT channel to use
+     * @param interval Tick period in system clock cycles
+     */
+    void start(unsigned chan, uint32_t interval);
+
+    void act() override;
+
+    explicit TimerWheel(lpc865::Mrt &mrt);
+
+private:
+    void insert(Timer &t);
+    void tick();
+
+    lpc865::Mrt &mrt_;
+    uint32_t now_;
+    uint32_t done_;         //!< MRT expiries processed so far
+    uint8_t chan_;
+    TimerLink wheel_[levels][slots];
+};
+
+//!@}
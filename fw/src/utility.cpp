@@ -0,0 +1,71 @@
+/** @file
+ * various utilities.
+ */
+module;
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+module utility;
+
+/** Mask of the bytes in a word that are nonzero.
+ * @return Bit i is set if byte i (in little endian order) is nonzero
+ */
+static inline uint32_t nonzeroBytes(uint32_t x) {
+    // The MSB of each byte gets set if any bit of the byte is set, without
+    // carries between the bytes. The multiplication then gathers the four
+    // MSBs in the top nibble.
+    uint32_t msb = (((x & 0x7F7F7F7F) + 0x7F7F7F7F) | x) & 0x80808080;
+    return ((msb >> 7) * 0x10204080) >> 28;
+}
+
+Diff diffCopy(std::span<std::byte> copy, std::span<std::byte const> src, std::span<uint32_t> changed) {
+    size_t size = std::min(copy.size(), src.size());
+    std::ranges::fill(changed, 0);
+    // Only the differences of the first and the last changed word are kept,
+    // and the changed bytes within them located after the loop, as the
+    // Cortex-M0+ has no instruction to count leading or trailing zeros. In
+    // the byte loop, a difference is a word with only its lowest byte set.
+    uint32_t firstX = 0;
+    uint32_t lastX = 0;
+    size_t firstAt = 0;
+    size_t lastAt = 0;
+    size_t i = 0;
+    if (((reinterpret_cast<uintptr_t>(copy.data()) | reinterpret_cast<uintptr_t>(src.data())) & 3) == 0) {
+        auto *d = reinterpret_cast<uint32_t *>(copy.data());
+        auto *s = reinterpret_cast<uint32_t const *>(src.data());
+        for (; i + 4 <= size; i += 4) {
+            uint32_t x = *s ^ *d;
+            *d++ = *s++;
+            if (x == 0)
+                continue;
+            if (!changed.empty())
+                changed[i / 32] |= nonzeroBytes(x) << (i % 32);
+            if (firstX == 0) {
+                firstX = x;
+                firstAt = i;
+            }
+            lastX = x;
+            lastAt = i;
+        }
+    }
+    for (; i < size; ++i) {
+        uint32_t x = uint32_t(copy[i] ^ src[i]);
+        copy[i] = src[i];
+        if (x == 0)
+            continue;
+        if (!changed.empty())
+            changed[i / 32] |= 1u << (i % 32);
+        if (firstX == 0) {
+            firstX = x;
+            firstAt = i;
+        }
+        lastX = x;
+        lastAt = i;
+    }
+    if (firstX == 0)
+        return Diff{ 0, 0 };
+    return Diff{ uint16_t(firstAt + std::countr_zero(nonzeroBytes(firstX))),
+                 uint16_t(lastAt + std::bit_width(nonzeroBytes(lastX))) };
+}
@@ -4,6 +4,9 @@
 
 module;
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
 #include <utility>
 export module utility;
 
@@ -18,3 +21,24 @@ export template <std::size_t N, typename T>
 constexpr std::array<T, N> make_array(T value) {
     return make_array_impl<T>(value, std::make_index_sequence<N>{});
 }
+
+/** Range of changed bytes found by diffCopy(). */
+export struct Diff {
+    uint16_t first;     //!< Offset of the first changed byte, or 0 if none
+    uint16_t last;      //!< Offset after the last changed byte, or 0 if none
+
+    explicit constexpr operator bool() const { return last != 0; }
+};
+
+/** Compare a buffer with its copy, and update the copy.
+ * @param copy The copy to update
+ * @param src The new data. Only the common length of both buffers is used.
+ * @param changed Bitmap receiving a bit for each byte that has changed, with
+ *                byte i in bit i % 32 of word i / 32. May be empty, otherwise
+ *                it needs to cover the common length.
+ * @return The range of changed bytes
+ *
+ * When both buffers are 4-byte aligned, this works on 32-bit words, in a
+ * single pass and without branches per byte. Otherwise it works byte by byte.
+ */
+export Diff diffCopy(std::span<std::byte> copy, std::span<std::byte const> src, std::span<uint32_t> changed = {});
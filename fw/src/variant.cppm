@@ -0,0 +1,31 @@
+/** @file
+ * Board variant descriptor.
+ *
+ * @addtogroup AES42HAT
+ * @{
+ */
+
+module;
+#include <cstdint>
+export module variant;
+
+/** Features of a board variant that concern the firmware.
+ *
+ * The variant is chosen at build time, with the CMake cache variables
+ * AES42HAT_CHANNELS and AES42HAT_AES42. Everything that exists per channel is
+ * sized from this descriptor at compile time, so that an image only contains
+ * code and RAM for the channels and features its board has.
+ */
+export struct Variant {
+    uint8_t channels;       //!< Number of SRC4392 channels fitted, 2 (32-pin spinoff) or 4 (octal)
+    bool aes42;             //!< AES42 phantom power monitoring fitted
+};
+
+export constexpr Variant variant{
+    .channels = VARIANT_CHANNELS,
+    .aes42 = VARIANT_AES42 != 0,
+};
+
+static_assert(variant.channels == 2 || variant.channels == 4, "Only 2 or 4 channels are supported");
+
+//!@}